@@ -0,0 +1,230 @@
+#include "AssetArchive.h"
+#include "Lz4.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+namespace {
+	const uint32_t ARCHIVE_MAGIC = 0x314b504c; //"LPK1"
+	const uint32_t ARCHIVE_VERSION = 1;
+	const uint64_t BLOB_ALIGNMENT = 16;
+
+	uint64_t alignUp(uint64_t value_, uint64_t alignment_)
+	{
+		return (value_ + alignment_ - 1) & ~(alignment_ - 1);
+	}
+}
+
+void AssetArchive::open(const std::string& path_)
+{
+	close();
+	m_view.open(path_);
+
+	//Everything the lookups dereference is validated once here, entry ranges are checked in load()
+	const Header* header = m_view.size() >= sizeof(Header) ? m_view.as<Header>() : nullptr;
+	if (!header || header->magic != ARCHIVE_MAGIC || header->version != ARCHIVE_VERSION || header->fileSize != m_view.size()
+		|| header->slotCount == 0 || (header->slotCount & (header->slotCount - 1)) != 0
+		|| header->namesOffset > m_view.size() || header->namesSize > m_view.size() - header->namesOffset) {
+		m_view.close();
+		throw std::runtime_error("'" + path_ + "' is not a valid asset archive [AssetArchive::open]");
+	}
+
+	m_header = header;
+	m_slots = m_view.as<TocSlot>(header->tocOffset, header->slotCount);
+	m_names = m_view.data() + header->namesOffset;
+}
+
+void AssetArchive::close()
+{
+	m_view.close();
+	m_header = nullptr;
+	m_slots = nullptr;
+	m_names = nullptr;
+}
+
+uint32_t AssetArchive::entryCount() const
+{
+	return m_header ? m_header->entryCount : 0;
+}
+
+bool AssetArchive::load(const std::string& name_, Asset& asset_) const
+{
+	const TocSlot* slot = findSlot(name_);
+	if (!slot) {
+		return false;
+	}
+
+	if (slot->offset > m_view.size() || slot->storedSize > m_view.size() - slot->offset) {
+		throw std::runtime_error("entry '" + name_ + "' lies outside of the archive [AssetArchive::load]");
+	}
+	const char* stored = m_view.data() + slot->offset;
+
+	if (slot->compression == static_cast<uint32_t>(Compression::None)) {
+		asset_.storage.clear();
+		asset_.data = stored;
+		asset_.size = static_cast<size_t>(slot->size);
+		return true;
+	}
+
+	//Words rather than bytes so the decompressed data is as aligned as a raw entry's
+	asset_.storage.resize(static_cast<size_t>((slot->size + sizeof(uint32_t) - 1) / sizeof(uint32_t)));
+	char* destination = reinterpret_cast<char*>(asset_.storage.data());
+	if (slot->compression != static_cast<uint32_t>(Compression::Lz4)
+		|| !Lz4::decompress(stored, static_cast<size_t>(slot->storedSize), destination, static_cast<size_t>(slot->size))) {
+		throw std::runtime_error("entry '" + name_ + "' is corrupt [AssetArchive::load]");
+	}
+
+	asset_.data = destination;
+	asset_.size = static_cast<size_t>(slot->size);
+	return true;
+}
+
+AssetArchive::PackStats AssetArchive::pack(const std::string& archivePath_, const std::vector<PackEntry>& entries_, bool compress_)
+{
+	PackStats stats;
+
+	//1. Hash table at most half full, names back to back
+	uint32_t slotCount = 1;
+	while (slotCount < entries_.size() * 2) {
+		slotCount *= 2;
+	}
+
+	std::vector<TocSlot> slots(slotCount);
+	memset(slots.data(), 0, slots.size() * sizeof(TocSlot));
+	std::string names;
+
+	std::vector<uint32_t> slotOfEntry(entries_.size());
+	for (size_t i = 0; i < entries_.size(); i++) {
+		const std::string& name = entries_[i].name;
+		if (name.empty()) {
+			throw std::runtime_error("archive entries need a name [AssetArchive::pack]");
+		}
+
+		uint64_t hash = hashName(name);
+		uint32_t index = static_cast<uint32_t>(hash) & (slotCount - 1);
+		while (slots[index].nameLength != 0) {
+			if (slots[index].nameHash == hash && names.compare(slots[index].nameOffset, slots[index].nameLength, name) == 0) {
+				throw std::runtime_error("duplicate archive entry '" + name + "' [AssetArchive::pack]");
+			}
+			index = (index + 1) & (slotCount - 1);
+		}
+
+		slots[index].nameHash = hash;
+		slots[index].nameOffset = static_cast<uint32_t>(names.size());
+		slots[index].nameLength = static_cast<uint32_t>(name.size());
+		names += name;
+		slotOfEntry[i] = index;
+	}
+
+	Header header = {};
+	header.magic = ARCHIVE_MAGIC;
+	header.version = ARCHIVE_VERSION;
+	header.entryCount = static_cast<uint32_t>(entries_.size());
+	header.slotCount = slotCount;
+	header.tocOffset = sizeof(Header);
+	header.namesOffset = header.tocOffset + slotCount * sizeof(TocSlot);
+	header.namesSize = names.size();
+
+	//2. Blobs, compressed when it pays off
+	std::vector<std::vector<char>> blobs(entries_.size());
+	uint64_t offset = alignUp(header.namesOffset + header.namesSize, BLOB_ALIGNMENT);
+	for (size_t i = 0; i < entries_.size(); i++) {
+		FileView file;
+		file.open(entries_[i].path);
+
+		TocSlot& slot = slots[slotOfEntry[i]];
+		slot.size = file.size();
+		slot.compression = static_cast<uint32_t>(Compression::None);
+		blobs[i].assign(file.data(), file.data() + file.size());
+
+		if (compress_ && file.size() > 0) {
+			std::vector<char> compressed(Lz4::compressBound(file.size()));
+			size_t compressedSize = Lz4::compress(file.data(), file.size(), compressed.data(), compressed.size());
+			if (compressedSize > 0 && compressedSize <= file.size() - file.size() / 8) {
+				compressed.resize(compressedSize);
+				blobs[i] = std::move(compressed);
+				slot.compression = static_cast<uint32_t>(Compression::Lz4);
+				stats.compressed++;
+			}
+		}
+
+		slot.offset = offset;
+		slot.storedSize = blobs[i].size();
+		offset = alignUp(offset + slot.storedSize, BLOB_ALIGNMENT);
+
+		stats.entries++;
+		stats.rawBytes += slot.size;
+		stats.storedBytes += slot.storedSize;
+	}
+	header.fileSize = offset;
+
+	//3. Write everything in file order
+	std::string tmpPath = archivePath_ + ".tmp";
+	{
+		std::ofstream file(tmpPath, std::ios::binary | std::ios::trunc);
+		if (!file.is_open()) {
+			throw std::runtime_error("failed to create '" + tmpPath + "' [AssetArchive::pack]");
+		}
+
+		const char padding[BLOB_ALIGNMENT] = {};
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		file.write(reinterpret_cast<const char*>(slots.data()), slots.size() * sizeof(TocSlot));
+		file.write(names.data(), names.size());
+		uint64_t written = header.namesOffset + header.namesSize;
+
+		for (size_t i = 0; i < entries_.size(); i++) {
+			const TocSlot& slot = slots[slotOfEntry[i]];
+			file.write(padding, static_cast<std::streamsize>(slot.offset - written));
+			file.write(blobs[i].data(), blobs[i].size());
+			written = slot.offset + slot.storedSize;
+		}
+		file.write(padding, static_cast<std::streamsize>(header.fileSize - written));
+
+		if (!file.good()) {
+			throw std::runtime_error("failed to write '" + tmpPath + "' [AssetArchive::pack]");
+		}
+	}
+
+	std::remove(archivePath_.c_str());
+	if (std::rename(tmpPath.c_str(), archivePath_.c_str()) != 0) {
+		throw std::runtime_error("failed to replace '" + archivePath_ + "' [AssetArchive::pack]");
+	}
+
+	stats.archiveBytes = header.fileSize;
+	return stats;
+}
+
+uint64_t AssetArchive::hashName(const std::string& name_)
+{
+	uint64_t hash = 14695981039346656037ull;
+	for (unsigned char c : name_) {
+		hash ^= c;
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+const AssetArchive::TocSlot* AssetArchive::findSlot(const std::string& name_) const
+{
+	if (!m_header) {
+		return nullptr;
+	}
+
+	uint64_t hash = hashName(name_);
+	uint32_t mask = m_header->slotCount - 1;
+	for (uint32_t probe = 0, index = static_cast<uint32_t>(hash) & mask; probe < m_header->slotCount; probe++, index = (index + 1) & mask) {
+		const TocSlot& slot = m_slots[index];
+		if (slot.nameLength == 0) {
+			return nullptr;
+		}
+
+		if (slot.nameHash == hash && slot.nameLength == name_.size()
+			&& slot.nameOffset <= m_header->namesSize && slot.nameLength <= m_header->namesSize - slot.nameOffset
+			&& memcmp(m_names + slot.nameOffset, name_.data(), name_.size()) == 0) {
+			return &slot;
+		}
+	}
+	return nullptr;
+}
@@ -0,0 +1,90 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "FileView.h"
+
+//Read-only pack of many small files, opened and mapped once.
+//Layout: Header | hash table of TocSlot | entry names | 16 byte aligned blobs.
+//Names are looked up by their 64 bit FNV-1a hash with linear probing, so a lookup touches one or two slots.
+//Entries are stored raw and used in place, or LZ4 compressed when that saves at least an eighth of their size.
+class AssetArchive {
+public:
+	enum class Compression : uint32_t { None = 0, Lz4 = 1 };
+
+	//Contents of one entry: points into the mapping for raw entries, into storage after decompression.
+	//Move only, a copy would point into the original's storage. Moving a vector keeps its buffer, so data stays valid.
+	struct Asset {
+		const char* data = nullptr;
+		size_t size = 0;
+		std::vector<uint32_t> storage;
+
+		Asset() = default;
+		Asset(Asset&& other_) noexcept = default;
+		Asset& operator=(Asset&& other_) noexcept = default;
+		Asset(const Asset&) = delete;
+		Asset& operator=(const Asset&) = delete;
+	};
+
+	struct PackEntry {
+		std::string name;
+		std::string path;
+	};
+
+	struct PackStats {
+		uint32_t entries = 0;
+		uint32_t compressed = 0;
+		uint64_t rawBytes = 0;
+		uint64_t storedBytes = 0;
+		uint64_t archiveBytes = 0;
+	};
+
+	//Throws if the file is missing or not a valid archive
+	void open(const std::string& path_);
+	void close();
+
+	bool isOpen() const { return m_header != nullptr; }
+	uint32_t entryCount() const;
+	size_t mappedBytes() const { return m_view.size(); }
+
+	bool contains(const std::string& name_) const { return findSlot(name_) != nullptr; }
+
+	//Returns false if there is no entry name_, throws if the entry is corrupt. Safe to call from several threads.
+	bool load(const std::string& name_, Asset& asset_) const;
+
+	//Writes an archive of entries_, through a temporary file so a running instance can keep the old one mapped
+	static PackStats pack(const std::string& archivePath_, const std::vector<PackEntry>& entries_, bool compress_);
+
+private:
+	struct Header {
+		uint32_t magic;
+		uint32_t version;
+		uint32_t entryCount;
+		uint32_t slotCount;		//Power of two, at least twice entryCount
+		uint64_t tocOffset;
+		uint64_t namesOffset;
+		uint64_t namesSize;
+		uint64_t fileSize;
+	};
+
+	//Empty slots have a nameLength of 0
+	struct TocSlot {
+		uint64_t nameHash;
+		uint32_t nameOffset;
+		uint32_t nameLength;
+		uint64_t offset;
+		uint64_t storedSize;
+		uint64_t size;
+		uint32_t compression;
+		uint32_t reserved;
+	};
+
+	static uint64_t hashName(const std::string& name_);
+	const TocSlot* findSlot(const std::string& name_) const;
+
+	FileView m_view;
+	const Header* m_header = nullptr;
+	const TocSlot* m_slots = nullptr;
+	const char* m_names = nullptr;
+};
@@ -0,0 +1,192 @@
+#include "BindlessTable.h"
+
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+void BindlessTable::create(VkDevice device_, uint32_t storageBufferCount_, uint32_t sampledImageCount_, const VkAllocationCallbacks* pAllocator_)
+{
+	m_device = device_;
+	m_pAllocator = pAllocator_;
+	m_storageBuffers = IndexArray();
+	m_storageBuffers.capacity = storageBufferCount_;
+	m_sampledImages = IndexArray();
+	m_sampledImages.capacity = sampledImageCount_;
+	m_descriptorWrites = 0;
+
+	//1. Layout, both arrays can be written while bound and only the slots shaders read need to be valid
+	VkDescriptorSetLayoutBinding bindings[2] = {};
+	bindings[0].binding = STORAGE_BUFFER_BINDING;
+	bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	bindings[0].descriptorCount = storageBufferCount_;
+	bindings[0].stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+	bindings[1].binding = SAMPLED_IMAGE_BINDING;
+	bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+	bindings[1].descriptorCount = sampledImageCount_;
+	bindings[1].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+	VkDescriptorBindingFlagsEXT bindingFlags[2] = {
+		VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT_EXT | VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT_EXT,
+		VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT_EXT | VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT_EXT,
+	};
+
+	VkDescriptorSetLayoutBindingFlagsCreateInfoEXT bindingFlagsInfo = {};
+	bindingFlagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO_EXT;
+	bindingFlagsInfo.bindingCount = 2;
+	bindingFlagsInfo.pBindingFlags = bindingFlags;
+
+	VkDescriptorSetLayoutCreateInfo layoutInfo = {};
+	layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutInfo.pNext = &bindingFlagsInfo;
+	layoutInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT_EXT;
+	layoutInfo.bindingCount = 2;
+	layoutInfo.pBindings = bindings;
+
+	if (vkCreateDescriptorSetLayout(m_device, &layoutInfo, m_pAllocator, &m_layout) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create bindless descriptor set layout! [BindlessTable::create]");
+	}
+
+	//2. A pool for exactly the one set
+	VkDescriptorPoolSize poolSizes[2] = {};
+	poolSizes[0].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	poolSizes[0].descriptorCount = storageBufferCount_;
+	poolSizes[1].type = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+	poolSizes[1].descriptorCount = sampledImageCount_;
+
+	VkDescriptorPoolCreateInfo poolInfo = {};
+	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT_EXT;
+	poolInfo.maxSets = 1;
+	poolInfo.poolSizeCount = 2;
+	poolInfo.pPoolSizes = poolSizes;
+
+	if (vkCreateDescriptorPool(m_device, &poolInfo, m_pAllocator, &m_pool) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create bindless descriptor pool! [BindlessTable::create]");
+	}
+
+	VkDescriptorSetAllocateInfo allocInfo = {};
+	allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocInfo.descriptorPool = m_pool;
+	allocInfo.descriptorSetCount = 1;
+	allocInfo.pSetLayouts = &m_layout;
+
+	if (vkAllocateDescriptorSets(m_device, &allocInfo, &m_set) != VK_SUCCESS) {
+		throw std::runtime_error("failed to allocate bindless descriptor set! [BindlessTable::create]");
+	}
+}
+
+void BindlessTable::destroy()
+{
+	if (m_layout == VK_NULL_HANDLE) {
+		return;
+	}
+
+	//Destroying the pool frees the set
+	vkDestroyDescriptorPool(m_device, m_pool, m_pAllocator);
+	vkDestroyDescriptorSetLayout(m_device, m_layout, m_pAllocator);
+	m_pool = VK_NULL_HANDLE;
+	m_layout = VK_NULL_HANDLE;
+	m_set = VK_NULL_HANDLE;
+}
+
+uint32_t BindlessTable::addStorageBuffer(VkBuffer buffer_, VkDeviceSize offset_, VkDeviceSize range_)
+{
+	uint32_t index = acquireIndex(m_storageBuffers, "storage buffer");
+
+	VkDescriptorBufferInfo bufferInfo = {};
+	bufferInfo.buffer = buffer_;
+	bufferInfo.offset = offset_;
+	bufferInfo.range = range_;
+	writeDescriptor(STORAGE_BUFFER_BINDING, index, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, &bufferInfo, nullptr);
+	return index;
+}
+
+uint32_t BindlessTable::addSampledImage(VkImageView view_, VkImageLayout layout_)
+{
+	uint32_t index = acquireIndex(m_sampledImages, "sampled image");
+
+	VkDescriptorImageInfo imageInfo = {};
+	imageInfo.imageView = view_;
+	imageInfo.imageLayout = layout_;
+	writeDescriptor(SAMPLED_IMAGE_BINDING, index, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, nullptr, &imageInfo);
+	return index;
+}
+
+//Partially bound, so the stale descriptor can stay until the index is reused
+void BindlessTable::removeStorageBuffer(uint32_t index_)
+{
+	releaseIndex(m_storageBuffers, index_, "storage buffer");
+}
+
+void BindlessTable::removeSampledImage(uint32_t index_)
+{
+	releaseIndex(m_sampledImages, index_, "sampled image");
+}
+
+uint32_t BindlessTable::acquireIndex(IndexArray& array_, const char* name_)
+{
+	uint32_t index;
+	if (!array_.freeIndices.empty()) {
+		index = array_.freeIndices.back();
+		array_.freeIndices.pop_back();
+	}
+	else if (array_.next < array_.capacity) {
+		index = array_.next++;
+	}
+	else {
+		throw std::runtime_error(std::string("bindless ") + name_ + " array of " + std::to_string(array_.capacity) + " is full [BindlessTable::acquireIndex]");
+	}
+
+	array_.live++;
+	array_.peak = std::max(array_.peak, array_.live);
+	return index;
+}
+
+void BindlessTable::releaseIndex(IndexArray& array_, uint32_t index_, const char* name_)
+{
+	if (index_ >= array_.next || std::find(array_.freeIndices.begin(), array_.freeIndices.end(), index_) != array_.freeIndices.end()) {
+		throw std::runtime_error(std::string("bindless ") + name_ + " " + std::to_string(index_) + " is not in use [BindlessTable::releaseIndex]");
+	}
+
+	array_.freeIndices.push_back(index_);
+	array_.live--;
+}
+
+void BindlessTable::writeDescriptor(uint32_t binding_, uint32_t index_, VkDescriptorType type_, const VkDescriptorBufferInfo* bufferInfo_, const VkDescriptorImageInfo* imageInfo_)
+{
+	VkWriteDescriptorSet descriptorWrite = {};
+	descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	descriptorWrite.dstSet = m_set;
+	descriptorWrite.dstBinding = binding_;
+	descriptorWrite.dstArrayElement = index_;
+	descriptorWrite.descriptorType = type_;
+	descriptorWrite.descriptorCount = 1;
+	descriptorWrite.pBufferInfo = bufferInfo_;
+	descriptorWrite.pImageInfo = imageInfo_;
+	vkUpdateDescriptorSets(m_device, 1, &descriptorWrite, 0, nullptr);
+
+	m_descriptorWrites++;
+}
+
+BindlessTable::Stats BindlessTable::stats() const
+{
+	Stats stats;
+	stats.storageBuffers = m_storageBuffers.live;
+	stats.sampledImages = m_sampledImages.live;
+	stats.peakStorageBuffers = m_storageBuffers.peak;
+	stats.peakSampledImages = m_sampledImages.peak;
+	stats.descriptorWrites = m_descriptorWrites;
+	return stats;
+}
+
+void BindlessTable::printStats() const
+{
+	if (m_layout == VK_NULL_HANDLE) {
+		return;
+	}
+
+	std::cout << "bindless table: " << m_storageBuffers.live << " of " << m_storageBuffers.capacity << " storage buffers (peak "
+		<< m_storageBuffers.peak << "), " << m_sampledImages.live << " of " << m_sampledImages.capacity << " sampled images (peak "
+		<< m_sampledImages.peak << "), " << m_descriptorWrites << " descriptor writes" << std::endl;
+}
@@ -0,0 +1,63 @@
+#pragma once
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <vector>
+
+//One descriptor set holding large arrays of storage buffers and sampled images (VK_EXT_descriptor_indexing).
+//Resources are registered once and referred to by their array index, which shaders receive through push constants,
+//so draws never bind descriptors. Bindings are update-after-bind and partially bound: slots can be filled while the
+//set is bound in pending command buffers, and slots no shader reads may stay empty.
+//A removed index may be handed out again right away, the caller must only remove it once no frame reads it.
+class BindlessTable {
+public:
+	static const uint32_t STORAGE_BUFFER_BINDING = 0;
+	static const uint32_t SAMPLED_IMAGE_BINDING = 1;
+
+	struct Stats {
+		uint32_t storageBuffers = 0;
+		uint32_t sampledImages = 0;
+		uint32_t peakStorageBuffers = 0;
+		uint32_t peakSampledImages = 0;
+		uint64_t descriptorWrites = 0;
+	};
+
+	void create(VkDevice device_, uint32_t storageBufferCount_, uint32_t sampledImageCount_, const VkAllocationCallbacks* pAllocator_);
+	void destroy();
+
+	uint32_t addStorageBuffer(VkBuffer buffer_, VkDeviceSize offset_, VkDeviceSize range_);
+	uint32_t addSampledImage(VkImageView view_, VkImageLayout layout_);
+	void removeStorageBuffer(uint32_t index_);
+	void removeSampledImage(uint32_t index_);
+
+	VkDescriptorSetLayout layout() const { return m_layout; }
+	VkDescriptorSet set() const { return m_set; }
+
+	Stats stats() const;
+	void printStats() const;
+
+private:
+	//Indices of one binding's array, freed ones are reused first
+	struct IndexArray {
+		uint32_t capacity = 0;
+		uint32_t next = 0;
+		std::vector<uint32_t> freeIndices;
+		uint32_t live = 0;
+		uint32_t peak = 0;
+	};
+
+	static uint32_t acquireIndex(IndexArray& array_, const char* name_);
+	static void releaseIndex(IndexArray& array_, uint32_t index_, const char* name_);
+	void writeDescriptor(uint32_t binding_, uint32_t index_, VkDescriptorType type_, const VkDescriptorBufferInfo* bufferInfo_, const VkDescriptorImageInfo* imageInfo_);
+
+	VkDevice m_device = VK_NULL_HANDLE;
+	const VkAllocationCallbacks* m_pAllocator = nullptr;
+
+	VkDescriptorSetLayout m_layout = VK_NULL_HANDLE;
+	VkDescriptorPool m_pool = VK_NULL_HANDLE;
+	VkDescriptorSet m_set = VK_NULL_HANDLE;
+
+	IndexArray m_storageBuffers;
+	IndexArray m_sampledImages;
+	uint64_t m_descriptorWrites = 0;
+};
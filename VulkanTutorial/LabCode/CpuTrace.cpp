@@ -0,0 +1,112 @@
+#include "CpuTrace.h"
+
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+std::atomic<bool> CpuTrace::s_enabled(false);
+
+namespace {
+
+	struct Event {
+		const char* name;
+		int64_t startNs;
+		int64_t durationNs;
+	};
+
+	//Single producer ring, only the owning thread writes, head is published with release so the exporter sees whole events
+	struct ThreadBuffer {
+		uint32_t threadId = 0;
+		std::vector<Event> events = std::vector<Event>(CpuTrace::EVENTS_PER_THREAD);
+		std::atomic<uint64_t> head{ 0 };
+	};
+
+	//Buffers are only registered once per thread and stay alive after the thread exits so they can still be exported
+	std::mutex g_registryMutex;
+	std::vector<std::unique_ptr<ThreadBuffer>> g_buffers;
+
+	ThreadBuffer& threadBuffer()
+	{
+		thread_local ThreadBuffer* buffer = nullptr;
+		if (!buffer) {
+			std::lock_guard<std::mutex> lock(g_registryMutex);
+			g_buffers.push_back(std::make_unique<ThreadBuffer>());
+			buffer = g_buffers.back().get();
+			buffer->threadId = static_cast<uint32_t>(g_buffers.size());
+		}
+		return *buffer;
+	}
+
+	const auto g_traceEpoch = std::chrono::steady_clock::now();
+
+	void writeJsonString(std::ofstream& file_, const char* text_)
+	{
+		file_ << '"';
+		for (const char* c = text_; *c; c++) {
+			if (*c == '"' || *c == '\\') {
+				file_ << '\\';
+			}
+			file_ << *c;
+		}
+		file_ << '"';
+	}
+}
+
+int64_t CpuTrace::nowNs()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - g_traceEpoch).count();
+}
+
+void CpuTrace::record(const char* name_, int64_t startNs_, int64_t endNs_)
+{
+	ThreadBuffer& buffer = threadBuffer();
+	uint64_t head = buffer.head.load(std::memory_order_relaxed);
+
+	buffer.events[head % EVENTS_PER_THREAD] = { name_, startNs_, endNs_ - startNs_ };
+	buffer.head.store(head + 1, std::memory_order_release);
+}
+
+bool CpuTrace::writeChromeJson(const std::string& filename_)
+{
+	std::ofstream file(filename_, std::ios::trunc);
+	if (!file.is_open()) {
+		std::cerr << "failed to open trace file '" << filename_ << "' [CpuTrace::writeChromeJson]" << std::endl;
+		return false;
+	}
+
+	std::lock_guard<std::mutex> lock(g_registryMutex);
+
+	//Complete ("X") events with microsecond timestamps, one track per thread
+	file << std::fixed << std::setprecision(3);
+	file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+	bool first = true;
+	uint64_t eventCount = 0;
+
+	for (const auto& buffer : g_buffers) {
+		uint64_t head = buffer->head.load(std::memory_order_acquire);
+		uint64_t begin = head > EVENTS_PER_THREAD ? head - EVENTS_PER_THREAD : 0;
+
+		file << (first ? "" : ",") << "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->threadId
+			<< ",\"args\":{\"name\":\"thread " << buffer->threadId << "\"}}";
+		first = false;
+
+		for (uint64_t i = begin; i < head; i++) {
+			const Event& event = buffer->events[i % EVENTS_PER_THREAD];
+
+			file << ",\n{\"name\":";
+			writeJsonString(file, event.name);
+			file << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->threadId
+				<< ",\"ts\":" << event.startNs / 1000.0
+				<< ",\"dur\":" << event.durationNs / 1000.0 << "}";
+		}
+		eventCount += head - begin;
+	}
+
+	file << "\n]}\n";
+	std::cout << "wrote " << eventCount << " trace events to '" << filename_ << "'" << std::endl;
+	return true;
+}
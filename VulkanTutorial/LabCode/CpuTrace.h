@@ -0,0 +1,49 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <atomic>
+
+//Scoped CPU timers exported as a Chrome / Perfetto JSON trace (chrome://tracing, ui.perfetto.dev).
+//Every thread writes into its own fixed size ring, so recording an event takes no lock.
+//When tracing is disabled a scope costs a single relaxed atomic load, define LAB_DISABLE_TRACE to compile scopes out entirely.
+class CpuTrace {
+public:
+	//Holds on to the most recent events per thread, older ones are overwritten
+	static const uint32_t EVENTS_PER_THREAD = 1 << 16;
+
+	static void setEnabled(bool enabled_) { s_enabled.store(enabled_, std::memory_order_relaxed); }
+	static bool isEnabled() { return s_enabled.load(std::memory_order_relaxed); }
+
+	static int64_t nowNs();
+
+	//name_ must outlive the trace, in practice a string literal
+	static void record(const char* name_, int64_t startNs_, int64_t endNs_);
+
+	//Call once the traced threads are idle, events being written during the export may be torn
+	static bool writeChromeJson(const std::string& filename_);
+
+	class Scope {
+	public:
+		explicit Scope(const char* name_) : m_name(isEnabled() ? name_ : nullptr), m_startNs(m_name ? nowNs() : 0) {}
+		~Scope() { if (m_name) record(m_name, m_startNs, nowNs()); }
+
+		Scope(const Scope&) = delete;
+		Scope& operator=(const Scope&) = delete;
+
+	private:
+		const char* m_name;
+		int64_t m_startNs;
+	};
+
+private:
+	static std::atomic<bool> s_enabled;
+};
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+
+#ifdef LAB_DISABLE_TRACE
+#define TRACE_SCOPE(name)
+#else
+#define TRACE_SCOPE(name) CpuTrace::Scope TRACE_CONCAT(traceScope_, __LINE__)(name)
+#endif
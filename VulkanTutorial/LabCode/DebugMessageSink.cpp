@@ -0,0 +1,219 @@
+#include "DebugMessageSink.h"
+
+#include <functional>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+
+namespace {
+
+	const char* severityName(VkDebugUtilsMessageSeverityFlagBitsEXT severity_)
+	{
+		switch (severity_) {
+		case VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT: return "error";
+		case VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT: return "warning";
+		case VK_DEBUG_UTILS_MESSAGE_SEVERITY_INFO_BIT_EXT: return "info";
+		default: return "verbose";
+		}
+	}
+}
+
+DebugMessageSink::DebugMessageSink()
+	: m_queue(QUEUE_CAPACITY)
+	, m_severityMask(VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT)
+	, m_typeMask(VK_DEBUG_UTILS_MESSAGE_TYPE_GENERAL_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_TYPE_VALIDATION_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_TYPE_PERFORMANCE_BIT_EXT)
+{
+}
+
+DebugMessageSink::~DebugMessageSink()
+{
+	stop();
+}
+
+void DebugMessageSink::start()
+{
+	if (m_running.exchange(true)) {
+		return;
+	}
+
+	m_secondStart = std::chrono::steady_clock::now();
+	m_consumer = std::thread(&DebugMessageSink::consumerLoop, this);
+}
+
+void DebugMessageSink::stop()
+{
+	if (!m_running.exchange(false)) {
+		return;
+	}
+
+	//Producers that saw m_running before it was cleared still push into the queue, wait for them so the drain sees it
+	while (m_activePushes.load() > 0) {
+		std::this_thread::yield();
+	}
+	m_consumer.join();
+
+	//1. Whatever arrived after the consumer's last pass
+	std::string output;
+	drain(output);
+
+	//2. Summary of everything which was not printed
+	std::ostringstream summary;
+	for (const auto& entry : m_repeats) {
+		if (entry.second.count > 1) {
+			summary << "validation layer: repeated " << entry.second.count - 1 << " more times: "
+				<< entry.second.text.substr(0, 120) << (entry.second.text.size() > 120 ? "..." : "") << "\n";
+		}
+	}
+	if (m_rateLimited > 0) {
+		summary << "validation layer: " << m_rateLimited << " messages suppressed by the rate limit\n";
+	}
+	if (m_dropped > 0) {
+		summary << "validation layer: " << m_dropped << " messages dropped, queue was full\n";
+	}
+
+	std::cerr << output << summary.str() << std::flush;
+	m_repeats.clear();
+}
+
+VkDebugUtilsMessageSeverityFlagsEXT DebugMessageSink::severityMaskFromName(const std::string& name_)
+{
+	VkDebugUtilsMessageSeverityFlagsEXT mask = VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT;
+	if (name_ == "error") {
+		return mask;
+	}
+
+	mask |= VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT;
+	if (name_ == "warning") {
+		return mask;
+	}
+
+	mask |= VK_DEBUG_UTILS_MESSAGE_SEVERITY_INFO_BIT_EXT;
+	if (name_ == "info") {
+		return mask;
+	}
+
+	mask |= VK_DEBUG_UTILS_MESSAGE_SEVERITY_VERBOSE_BIT_EXT;
+	if (name_ == "verbose") {
+		return mask;
+	}
+
+	throw std::runtime_error("unknown debug severity '" + name_ + "' [DebugMessageSink::severityMaskFromName]");
+}
+
+VkDebugUtilsMessageTypeFlagsEXT DebugMessageSink::typeMaskFromList(const std::string& list_)
+{
+	VkDebugUtilsMessageTypeFlagsEXT mask = 0;
+
+	std::istringstream stream(list_);
+	std::string type;
+	while (std::getline(stream, type, ',')) {
+		if (type == "general") {
+			mask |= VK_DEBUG_UTILS_MESSAGE_TYPE_GENERAL_BIT_EXT;
+		}
+		else if (type == "validation") {
+			mask |= VK_DEBUG_UTILS_MESSAGE_TYPE_VALIDATION_BIT_EXT;
+		}
+		else if (type == "performance") {
+			mask |= VK_DEBUG_UTILS_MESSAGE_TYPE_PERFORMANCE_BIT_EXT;
+		}
+		else {
+			throw std::runtime_error("unknown debug message type '" + type + "' [DebugMessageSink::typeMaskFromList]");
+		}
+	}
+
+	return mask;
+}
+
+VKAPI_ATTR VkBool32 VKAPI_CALL DebugMessageSink::callback(
+	VkDebugUtilsMessageSeverityFlagBitsEXT messageSeverity_,
+	VkDebugUtilsMessageTypeFlagsEXT messageType_,
+	const VkDebugUtilsMessengerCallbackDataEXT* pCallbackData_,
+	void* pUserData_)
+{
+	DebugMessageSink* sink = static_cast<DebugMessageSink*>(pUserData_);
+
+	if ((messageSeverity_ & sink->severityMask()) && (messageType_ & sink->typeMask())) {
+		sink->push(messageSeverity_, pCallbackData_);
+	}
+
+	//return false to not abort the vulkan call that triggered this callback
+	return VK_FALSE;
+}
+
+void DebugMessageSink::push(VkDebugUtilsMessageSeverityFlagBitsEXT severity_, const VkDebugUtilsMessengerCallbackDataEXT* pCallbackData_)
+{
+	const char* text = pCallbackData_->pMessage ? pCallbackData_->pMessage : "";
+
+	//Registered before the m_running check, so stop() cannot drain between the check and the push
+	m_activePushes.fetch_add(1);
+
+	//Messages from before start() or after stop() are printed straight away, nobody would drain them.
+	//Sequentially consistent with the exchange in stop(), either stop() sees the count or this sees the flag cleared.
+	if (!m_running.load()) {
+		m_activePushes.fetch_sub(1);
+		std::cerr << "validation layer: " << text << std::endl;
+		return;
+	}
+
+	Message message;
+	message.severity = severity_;
+	message.messageId = pCallbackData_->messageIdNumber;
+	message.text = text;
+
+	if (!m_queue.push(std::move(message))) {
+		m_dropped.fetch_add(1, std::memory_order_relaxed);
+	}
+	m_activePushes.fetch_sub(1);
+}
+
+void DebugMessageSink::consumerLoop()
+{
+	std::string output;
+
+	while (m_running.load(std::memory_order_acquire)) {
+		drain(output);
+		if (!output.empty()) {
+			std::cerr << output << std::flush;
+			output.clear();
+		}
+
+		//Batch up whatever arrives in the meantime into one write
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	}
+}
+
+void DebugMessageSink::drain(std::string& output_)
+{
+	Message message;
+	while (m_queue.pop(message)) {
+		//Not every message has an id, fall back to the text for those
+		uint64_t key = message.messageId != 0
+			? static_cast<uint32_t>(message.messageId)
+			: (std::hash<std::string>()(message.text) | (1ull << 63));
+
+		Repeat& repeat = m_repeats[key];
+		if (repeat.count++ > 0) {
+			continue;
+		}
+		repeat.text = message.text;
+
+		auto now = std::chrono::steady_clock::now();
+		if (now - m_secondStart >= std::chrono::seconds(1)) {
+			m_secondStart = now;
+			m_linesThisSecond = 0;
+		}
+
+		bool isError = message.severity == VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT;
+		if (!isError && m_maxLinesPerSecond > 0 && m_linesThisSecond >= m_maxLinesPerSecond) {
+			m_rateLimited++;
+			continue;
+		}
+		m_linesThisSecond++;
+
+		output_ += "validation layer [";
+		output_ += severityName(message.severity);
+		output_ += "]: ";
+		output_ += message.text;
+		output_ += "\n";
+	}
+}
@@ -0,0 +1,85 @@
+#pragma once
+#include <vulkan/vulkan.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+#include "MpscQueue.h"
+
+//Receives VK_EXT_debug_utils messages and prints them from a background thread.
+//The messenger callback only filters and pushes into a lock-free queue, so driver threads never wait on console output.
+//Repeated messages (same messageIdNumber) are printed once and counted, and output is capped at a number of lines
+//per second. Errors are never rate limited.
+class DebugMessageSink {
+public:
+	DebugMessageSink();
+	~DebugMessageSink();
+
+	DebugMessageSink(const DebugMessageSink&) = delete;
+	DebugMessageSink& operator=(const DebugMessageSink&) = delete;
+
+	void start();
+
+	//Drains what is still queued and prints the repeat and drop summary
+	void stop();
+
+	//Runtime filters, messages outside of the masks are dropped in the callback
+	void setSeverityMask(VkDebugUtilsMessageSeverityFlagsEXT mask_) { m_severityMask.store(mask_, std::memory_order_relaxed); }
+	void setTypeMask(VkDebugUtilsMessageTypeFlagsEXT mask_) { m_typeMask.store(mask_, std::memory_order_relaxed); }
+	VkDebugUtilsMessageSeverityFlagsEXT severityMask() const { return m_severityMask.load(std::memory_order_relaxed); }
+	VkDebugUtilsMessageTypeFlagsEXT typeMask() const { return m_typeMask.load(std::memory_order_relaxed); }
+
+	//0 disables the limit
+	void setMaxLinesPerSecond(uint32_t lines_) { m_maxLinesPerSecond = lines_; }
+
+	//Severity flags including every more severe level, from "verbose", "info", "warning" or "error"
+	static VkDebugUtilsMessageSeverityFlagsEXT severityMaskFromName(const std::string& name_);
+
+	//Type flags from a comma separated list of "general", "validation" and "performance"
+	static VkDebugUtilsMessageTypeFlagsEXT typeMaskFromList(const std::string& list_);
+
+	//Use as pfnUserCallback with the sink as pUserData
+	static VKAPI_ATTR VkBool32 VKAPI_CALL callback(
+		VkDebugUtilsMessageSeverityFlagBitsEXT messageSeverity_,
+		VkDebugUtilsMessageTypeFlagsEXT messageType_,
+		const VkDebugUtilsMessengerCallbackDataEXT* pCallbackData_,
+		void* pUserData_);
+
+private:
+	static const size_t QUEUE_CAPACITY = 4096;
+
+	struct Message {
+		VkDebugUtilsMessageSeverityFlagBitsEXT severity = VK_DEBUG_UTILS_MESSAGE_SEVERITY_VERBOSE_BIT_EXT;
+		int32_t messageId = 0;
+		std::string text;
+	};
+
+	struct Repeat {
+		uint64_t count = 0;
+		std::string text;
+	};
+
+	void push(VkDebugUtilsMessageSeverityFlagBitsEXT severity_, const VkDebugUtilsMessengerCallbackDataEXT* pCallbackData_);
+	void consumerLoop();
+	void drain(std::string& output_);
+
+	MpscQueue<Message> m_queue;
+	std::thread m_consumer;
+	std::atomic<bool> m_running{ false };
+	std::atomic<uint32_t> m_activePushes{ 0 };	//Producers between their m_running check and their push
+	std::atomic<uint64_t> m_dropped{ 0 };
+
+	std::atomic<VkDebugUtilsMessageSeverityFlagsEXT> m_severityMask;
+	std::atomic<VkDebugUtilsMessageTypeFlagsEXT> m_typeMask;
+
+	//Consumer thread only
+	uint32_t m_maxLinesPerSecond = 20;
+	uint32_t m_linesThisSecond = 0;
+	uint64_t m_rateLimited = 0;
+	std::chrono::steady_clock::time_point m_secondStart;
+	std::unordered_map<uint64_t, Repeat> m_repeats;
+};
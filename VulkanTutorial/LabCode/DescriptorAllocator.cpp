@@ -0,0 +1,208 @@
+#include "DescriptorAllocator.h"
+
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+
+namespace {
+
+	//Descriptors of each type per set a pool is sized for
+	struct PoolRatio {
+		VkDescriptorType type;
+		float perSet;
+	};
+
+	const PoolRatio POOL_RATIOS[] = {
+		{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1.0f },
+		{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1.0f },
+		{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1.0f },
+		{ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2.0f },
+		{ VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, 1.0f },
+		{ VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 0.5f },
+		{ VK_DESCRIPTOR_TYPE_SAMPLER, 0.5f },
+	};
+
+	void hashBytes(uint64_t& hash_, const void* data_, size_t size_)
+	{
+		const unsigned char* bytes = static_cast<const unsigned char*>(data_);
+		for (size_t i = 0; i < size_; i++) {
+			hash_ ^= bytes[i];
+			hash_ *= 1099511628211ull;
+		}
+	}
+}
+
+bool DescriptorAllocator::LayoutKey::operator==(const LayoutKey& other_) const
+{
+	return std::equal(bindings.begin(), bindings.end(), other_.bindings.begin(), other_.bindings.end(),
+		[](const VkDescriptorSetLayoutBinding& a_, const VkDescriptorSetLayoutBinding& b_) {
+			return a_.binding == b_.binding && a_.descriptorType == b_.descriptorType && a_.descriptorCount == b_.descriptorCount
+				&& a_.stageFlags == b_.stageFlags && a_.pImmutableSamplers == b_.pImmutableSamplers;
+		});
+}
+
+size_t DescriptorAllocator::LayoutKeyHash::operator()(const LayoutKey& key_) const
+{
+	//FNV-1a over the fields, not the structs, so padding never takes part
+	uint64_t hash = 14695981039346656037ull;
+	for (const VkDescriptorSetLayoutBinding& binding : key_.bindings) {
+		hashBytes(hash, &binding.binding, sizeof(binding.binding));
+		hashBytes(hash, &binding.descriptorType, sizeof(binding.descriptorType));
+		hashBytes(hash, &binding.descriptorCount, sizeof(binding.descriptorCount));
+		hashBytes(hash, &binding.stageFlags, sizeof(binding.stageFlags));
+		hashBytes(hash, &binding.pImmutableSamplers, sizeof(binding.pImmutableSamplers));
+	}
+	return static_cast<size_t>(hash);
+}
+
+void DescriptorAllocator::create(VkDevice device_, uint32_t slotCount_, const VkAllocationCallbacks* pAllocator_)
+{
+	m_device = device_;
+	m_pAllocator = pAllocator_;
+	m_slots.resize(slotCount_);
+}
+
+void DescriptorAllocator::destroy()
+{
+	for (Slot& slot : m_slots) {
+		for (Pool& pool : slot.usedPools) {
+			vkDestroyDescriptorPool(m_device, pool.pool, m_pAllocator);
+		}
+	}
+	for (Pool& pool : m_freePools) {
+		vkDestroyDescriptorPool(m_device, pool.pool, m_pAllocator);
+	}
+	for (auto& layout : m_layouts) {
+		vkDestroyDescriptorSetLayout(m_device, layout.second, m_pAllocator);
+	}
+
+	m_slots.clear();
+	m_freePools.clear();
+	m_layouts.clear();
+}
+
+VkDescriptorSetLayout DescriptorAllocator::getLayout(const std::vector<VkDescriptorSetLayoutBinding>& bindings_)
+{
+	//1. The same bindings listed in another order are the same layout
+	LayoutKey key;
+	key.bindings = bindings_;
+	std::sort(key.bindings.begin(), key.bindings.end(),
+		[](const VkDescriptorSetLayoutBinding& a_, const VkDescriptorSetLayoutBinding& b_) { return a_.binding < b_.binding; });
+
+	auto it = m_layouts.find(key);
+	if (it != m_layouts.end()) {
+		m_stats.layoutCacheHits++;
+		return it->second;
+	}
+
+	//2. Miss
+	VkDescriptorSetLayoutCreateInfo layoutInfo = {};
+	layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutInfo.bindingCount = static_cast<uint32_t>(key.bindings.size());
+	layoutInfo.pBindings = key.bindings.data();
+
+	VkDescriptorSetLayout layout;
+	if (vkCreateDescriptorSetLayout(m_device, &layoutInfo, m_pAllocator, &layout) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create descriptor set layout! [DescriptorAllocator::getLayout]");
+	}
+
+	m_stats.layoutsCreated++;
+	m_layouts.emplace(std::move(key), layout);
+	return layout;
+}
+
+VkDescriptorSet DescriptorAllocator::allocate(uint32_t slot_, VkDescriptorSetLayout layout_)
+{
+	if (slot_ >= m_slots.size()) {
+		throw std::runtime_error("descriptor allocator slot out of range [DescriptorAllocator::allocate]");
+	}
+	Slot& slot = m_slots[slot_];
+	if (slot.usedPools.empty()) {
+		slot.usedPools.push_back(acquirePool(slot));
+	}
+
+	VkDescriptorSetAllocateInfo allocInfo = {};
+	allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocInfo.descriptorPool = slot.usedPools.back().pool;
+	allocInfo.descriptorSetCount = 1;
+	allocInfo.pSetLayouts = &layout_;
+
+	VkDescriptorSet descriptorSet;
+	VkResult result = vkAllocateDescriptorSets(m_device, &allocInfo, &descriptorSet);
+
+	//Full pools stay with the slot until its reset, the next one is tried once
+	if (result == VK_ERROR_OUT_OF_POOL_MEMORY || result == VK_ERROR_FRAGMENTED_POOL) {
+		slot.usedPools.push_back(acquirePool(slot));
+		allocInfo.descriptorPool = slot.usedPools.back().pool;
+		result = vkAllocateDescriptorSets(m_device, &allocInfo, &descriptorSet);
+	}
+
+	if (result != VK_SUCCESS) {
+		throw std::runtime_error("failed to allocate descriptor set! [DescriptorAllocator::allocate]");
+	}
+
+	m_stats.setsAllocated++;
+	return descriptorSet;
+}
+
+void DescriptorAllocator::resetSlot(uint32_t slot_)
+{
+	if (slot_ >= m_slots.size()) {
+		throw std::runtime_error("descriptor allocator slot out of range [DescriptorAllocator::resetSlot]");
+	}
+
+	Slot& slot = m_slots[slot_];
+	for (Pool& pool : slot.usedPools) {
+		vkResetDescriptorPool(m_device, pool.pool, 0);
+		m_freePools.push_back(pool);
+		m_stats.poolResets++;
+	}
+	slot.usedPools.clear();
+}
+
+DescriptorAllocator::Pool DescriptorAllocator::acquirePool(Slot& slot_)
+{
+	//Largest recycled pool first, a slot that needed many sets last frame probably needs them again
+	auto largest = std::max_element(m_freePools.begin(), m_freePools.end(),
+		[](const Pool& a_, const Pool& b_) { return a_.maxSets < b_.maxSets; });
+	if (largest != m_freePools.end()) {
+		Pool pool = *largest;
+		m_freePools.erase(largest);
+		return pool;
+	}
+
+	Pool pool;
+	pool.maxSets = slot_.nextMaxSets;
+	pool.pool = createPool(pool.maxSets);
+	slot_.nextMaxSets = slot_.nextMaxSets * 2 < MAX_POOL_SETS ? slot_.nextMaxSets * 2 : MAX_POOL_SETS;
+	return pool;
+}
+
+VkDescriptorPool DescriptorAllocator::createPool(uint32_t maxSets_)
+{
+	std::vector<VkDescriptorPoolSize> poolSizes;
+	for (const PoolRatio& ratio : POOL_RATIOS) {
+		poolSizes.push_back({ ratio.type, std::max(1u, static_cast<uint32_t>(ratio.perSet * maxSets_)) });
+	}
+
+	VkDescriptorPoolCreateInfo poolInfo = {};
+	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolInfo.maxSets = maxSets_;
+	poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+	poolInfo.pPoolSizes = poolSizes.data();
+
+	VkDescriptorPool pool;
+	if (vkCreateDescriptorPool(m_device, &poolInfo, m_pAllocator, &pool) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create descriptor pool! [DescriptorAllocator::createPool]");
+	}
+
+	m_stats.poolsCreated++;
+	return pool;
+}
+
+void DescriptorAllocator::printStats() const
+{
+	std::cout << "descriptor allocator: " << m_stats.setsAllocated << " sets from " << m_stats.poolsCreated << " pools"
+		<< ", " << m_stats.poolResets << " pool resets, " << m_stats.layoutsCreated << " layouts ("
+		<< m_stats.layoutCacheHits << " cache hits)" << std::endl;
+}
@@ -0,0 +1,73 @@
+#pragma once
+#include <vulkan/vulkan.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+//Descriptor sets from growable lists of pools, one list per slot.
+//A slot is either a frame in flight, whose pools are all reset with vkResetDescriptorPool once its fence has signaled,
+//or a long lived slot which is never reset. Sets are never freed one by one, so pools do not fragment and an
+//allocation is a single vkAllocateDescriptorSets on the slot's current pool. When that pool runs out the slot moves
+//on to a recycled pool or a new one twice as large as the last.
+//Set layouts are cached by their bindings, asking twice for the same bindings returns the same layout.
+//Not thread safe, a slot must only be used by one thread at a time.
+class DescriptorAllocator {
+public:
+	struct Stats {
+		uint64_t setsAllocated = 0;
+		uint64_t poolResets = 0;
+		uint32_t poolsCreated = 0;
+		uint32_t layoutsCreated = 0;
+		uint64_t layoutCacheHits = 0;
+	};
+
+	void create(VkDevice device_, uint32_t slotCount_, const VkAllocationCallbacks* pAllocator_);
+	void destroy();
+
+	//Owned by the cache until destroy()
+	VkDescriptorSetLayout getLayout(const std::vector<VkDescriptorSetLayoutBinding>& bindings_);
+
+	VkDescriptorSet allocate(uint32_t slot_, VkDescriptorSetLayout layout_);
+
+	//Every set allocated from slot_ becomes invalid, whatever used them must have completed
+	void resetSlot(uint32_t slot_);
+
+	const Stats& stats() const { return m_stats; }
+	void printStats() const;
+
+private:
+	static const uint32_t FIRST_POOL_SETS = 64;
+	static const uint32_t MAX_POOL_SETS = 4096;
+
+	struct Pool {
+		VkDescriptorPool pool;
+		uint32_t maxSets;
+	};
+
+	struct Slot {
+		std::vector<Pool> usedPools;	//The last one is current
+		uint32_t nextMaxSets = FIRST_POOL_SETS;
+	};
+
+	struct LayoutKey {
+		std::vector<VkDescriptorSetLayoutBinding> bindings;	//Sorted by binding
+		bool operator==(const LayoutKey& other_) const;
+	};
+
+	struct LayoutKeyHash {
+		size_t operator()(const LayoutKey& key_) const;
+	};
+
+	Pool acquirePool(Slot& slot_);
+	VkDescriptorPool createPool(uint32_t maxSets_);
+
+	VkDevice m_device = VK_NULL_HANDLE;
+	const VkAllocationCallbacks* m_pAllocator = nullptr;
+
+	std::vector<Slot> m_slots;
+	std::vector<Pool> m_freePools;	//Reset pools ready for any slot
+	std::unordered_map<LayoutKey, VkDescriptorSetLayout, LayoutKeyHash> m_layouts;
+	Stats m_stats;
+};
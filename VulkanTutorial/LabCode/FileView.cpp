@@ -0,0 +1,125 @@
+#include "FileView.h"
+
+#include <utility>
+
+#ifdef _WIN32
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+FileView::FileView(FileView&& other_) noexcept
+	: m_data(std::exchange(other_.m_data, nullptr))
+	, m_size(std::exchange(other_.m_size, 0))
+	, m_open(std::exchange(other_.m_open, false))
+{
+}
+
+FileView& FileView::operator=(FileView&& other_) noexcept
+{
+	if (this != &other_) {
+		close();
+		m_data = std::exchange(other_.m_data, nullptr);
+		m_size = std::exchange(other_.m_size, 0);
+		m_open = std::exchange(other_.m_open, false);
+	}
+	return *this;
+}
+
+void FileView::open(const std::string& path_)
+{
+	if (!tryOpen(path_)) {
+		throw std::runtime_error("failed to map file '" + path_ + "' [FileView::open]");
+	}
+}
+
+bool FileView::tryOpen(const std::string& path_)
+{
+	close();
+
+	//Empty files are valid but cannot be mapped, they open with a null data pointer
+	size_t size = 0;
+	const char* data = nullptr;
+
+#ifdef _WIN32
+	HANDLE file = CreateFileA(path_.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE) {
+		return false;
+	}
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(file, &fileSize)) {
+		CloseHandle(file);
+		return false;
+	}
+	size = static_cast<size_t>(fileSize.QuadPart);
+
+	if (size > 0) {
+		HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		void* view = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+
+		//The view keeps the mapping and the file alive on its own
+		if (mapping) {
+			CloseHandle(mapping);
+		}
+		if (!view) {
+			CloseHandle(file);
+			return false;
+		}
+		data = static_cast<const char*>(view);
+	}
+	CloseHandle(file);
+#else
+	int file = ::open(path_.c_str(), O_RDONLY | O_CLOEXEC);
+	if (file < 0) {
+		return false;
+	}
+
+	struct stat fileStat;
+	if (fstat(file, &fileStat) != 0) {
+		::close(file);
+		return false;
+	}
+	size = static_cast<size_t>(fileStat.st_size);
+
+	if (size > 0) {
+		void* view = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, file, 0);
+		if (view == MAP_FAILED) {
+			::close(file);
+			return false;
+		}
+
+		//Assets are read front to back right after opening
+		madvise(view, size, MADV_WILLNEED);
+		data = static_cast<const char*>(view);
+	}
+
+	//The mapping holds its own reference to the file
+	::close(file);
+#endif
+
+	m_data = data;
+	m_size = size;
+	m_open = true;
+	return true;
+}
+
+void FileView::close()
+{
+	if (m_data) {
+#ifdef _WIN32
+		UnmapViewOfFile(m_data);
+#else
+		munmap(const_cast<char*>(m_data), m_size);
+#endif
+	}
+
+	m_data = nullptr;
+	m_size = 0;
+	m_open = false;
+}
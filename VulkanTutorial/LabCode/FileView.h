@@ -0,0 +1,48 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+
+//Read-only memory mapping of a whole file, the pages are loaded by the OS on first touch instead of copied up front.
+//The mapping starts on a page boundary, so its contents can be read in place as uint32_t words (SPIR-V) or headers.
+//Pointers into the view stay valid until it is closed, moved from or destroyed. Files which are replaced while
+//mapped must be replaced through a rename, truncating a mapped file in place is undefined.
+class FileView {
+public:
+	FileView() = default;
+	~FileView() { close(); }
+
+	FileView(FileView&& other_) noexcept;
+	FileView& operator=(FileView&& other_) noexcept;
+	FileView(const FileView&) = delete;
+	FileView& operator=(const FileView&) = delete;
+
+	//Throws if the file cannot be opened or mapped
+	void open(const std::string& path_);
+	//Returns false instead of throwing, for files which are allowed to be missing
+	bool tryOpen(const std::string& path_);
+	void close();
+
+	bool isOpen() const { return m_open; }
+	const char* data() const { return m_data; }
+	size_t size() const { return m_size; }
+
+	//count_ elements of T starting offset_ bytes into the file, throws when out of bounds or misaligned
+	template<typename T>
+	const T* as(size_t offset_ = 0, size_t count_ = 1) const
+	{
+		if (offset_ > m_size || count_ > (m_size - offset_) / sizeof(T)) {
+			throw std::runtime_error("read past the end of a mapped file [FileView::as]");
+		}
+		if (reinterpret_cast<uintptr_t>(m_data + offset_) % alignof(T) != 0) {
+			throw std::runtime_error("misaligned read from a mapped file [FileView::as]");
+		}
+		return reinterpret_cast<const T*>(m_data + offset_);
+	}
+
+private:
+	const char* m_data = nullptr;
+	size_t m_size = 0;
+	bool m_open = false;
+};
@@ -0,0 +1,129 @@
+#include "FileWatcher.h"
+
+#include <filesystem>
+#include <iostream>
+
+#ifdef __linux__
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+#ifndef __linux__
+	int64_t writeTime(const std::string& path_)
+	{
+		std::error_code error;
+		auto time = std::filesystem::last_write_time(path_, error);
+		return error ? 0 : static_cast<int64_t>(time.time_since_epoch().count());
+	}
+#endif
+}
+
+void FileWatcher::create()
+{
+#ifdef __linux__
+	m_inotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (m_inotify < 0) {
+		std::cerr << "inotify unavailable, file changes will not be reported [FileWatcher::create]" << std::endl;
+	}
+#else
+	m_lastPoll = std::chrono::steady_clock::now();
+#endif
+}
+
+void FileWatcher::destroy()
+{
+#ifdef __linux__
+	if (m_inotify >= 0) {
+		close(m_inotify);
+		m_inotify = -1;
+	}
+	m_directories.clear();
+#else
+	m_writeTimes.clear();
+#endif
+	m_files.clear();
+}
+
+void FileWatcher::watch(const std::string& path_)
+{
+	std::string path = normalize(path_);
+	if (!m_files.insert(path).second) {
+		return;
+	}
+
+#ifdef __linux__
+	if (m_inotify < 0) {
+		return;
+	}
+
+	//One watch per directory, inotify hands back the same descriptor when a directory is added twice
+	std::string directory = std::filesystem::path(path).parent_path().generic_string();
+	int watchDescriptor = inotify_add_watch(m_inotify, directory.empty() ? "." : directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+	if (watchDescriptor < 0) {
+		std::cerr << "failed to watch '" << directory << "' [FileWatcher::watch]" << std::endl;
+		return;
+	}
+	m_directories[watchDescriptor] = directory;
+#else
+	m_writeTimes[path] = writeTime(path);
+#endif
+}
+
+void FileWatcher::poll(std::vector<std::string>& changed_)
+{
+	std::set<std::string> changed;
+
+#ifdef __linux__
+	if (m_inotify < 0) {
+		return;
+	}
+
+	alignas(inotify_event) char buffer[4096];
+	for (;;) {
+		ssize_t length = read(m_inotify, buffer, sizeof(buffer));
+		if (length <= 0) {
+			break;
+		}
+
+		for (ssize_t offset = 0; offset < length; ) {
+			const inotify_event* event = reinterpret_cast<const inotify_event*>(buffer + offset);
+			offset += sizeof(inotify_event) + event->len;
+
+			auto directory = m_directories.find(event->wd);
+			if (directory == m_directories.end() || event->len == 0) {
+				continue;
+			}
+
+			std::string path = normalize((std::filesystem::path(directory->second) / event->name).generic_string());
+			if (m_files.count(path)) {
+				changed.insert(path);
+			}
+		}
+	}
+#else
+	auto now = std::chrono::steady_clock::now();
+	if (now - m_lastPoll < POLL_INTERVAL) {
+		return;
+	}
+	m_lastPoll = now;
+
+	for (auto& entry : m_writeTimes) {
+		int64_t time = writeTime(entry.first);
+		if (time != entry.second) {
+			entry.second = time;
+			changed.insert(entry.first);
+		}
+	}
+#endif
+
+	changed_.insert(changed_.end(), changed.begin(), changed.end());
+}
+
+std::string FileWatcher::normalize(const std::string& path_)
+{
+	return std::filesystem::path(path_).lexically_normal().generic_string();
+}
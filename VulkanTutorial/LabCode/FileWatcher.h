@@ -0,0 +1,37 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+//Reports modifications of a set of files without blocking.
+//Linux uses inotify on the parent directories, so editors which save through a rename are caught as well.
+//Elsewhere the modification times are compared, at most every POLL_INTERVAL.
+class FileWatcher {
+public:
+	void create();
+	void destroy();
+
+	//Paths are compared after normalization, watching the same file twice is harmless
+	void watch(const std::string& path_);
+
+	//Appends the watched files modified since the last call, each at most once
+	void poll(std::vector<std::string>& changed_);
+
+private:
+	static std::string normalize(const std::string& path_);
+
+	std::set<std::string> m_files;
+
+#ifdef __linux__
+	int m_inotify = -1;
+	std::map<int, std::string> m_directories;
+#else
+	static constexpr std::chrono::milliseconds POLL_INTERVAL{ 250 };
+
+	std::map<std::string, int64_t> m_writeTimes;
+	std::chrono::steady_clock::time_point m_lastPoll;
+#endif
+};
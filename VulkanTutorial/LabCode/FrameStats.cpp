@@ -0,0 +1,39 @@
+#include "FrameStats.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+void FrameStats::addSample(double frameMs_)
+{
+	m_samplesMs.push_back(frameMs_);
+	m_totalMs += frameMs_;
+}
+
+double FrameStats::percentileMs(double percentile_) const
+{
+	if (m_samplesMs.empty()) {
+		return 0.0;
+	}
+
+	std::vector<double> sorted = m_samplesMs;
+	size_t rank = static_cast<size_t>(std::ceil(percentile_ / 100.0 * sorted.size()));
+	size_t index = std::min(sorted.size() - 1, rank > 0 ? rank - 1 : 0);
+
+	std::nth_element(sorted.begin(), sorted.begin() + index, sorted.end());
+	return sorted[index];
+}
+
+void FrameStats::print(const std::string& label_) const
+{
+	if (m_samplesMs.empty()) {
+		return;
+	}
+
+	std::cout << label_ << ": " << m_samplesMs.size() << " frames, " << framesPerSecond() << " fps"
+		<< ", avg " << averageMs() << " ms"
+		<< ", p50 " << percentileMs(50.0) << " ms"
+		<< ", p90 " << percentileMs(90.0) << " ms"
+		<< ", p99 " << percentileMs(99.0) << " ms"
+		<< ", max " << percentileMs(100.0) << " ms" << std::endl;
+}
@@ -0,0 +1,24 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+//Collects per frame CPU times and reports throughput and percentiles
+class FrameStats {
+public:
+	void reset() { m_samplesMs.clear(); m_totalMs = 0.0; }
+	void addSample(double frameMs_);
+
+	size_t count() const { return m_samplesMs.size(); }
+	double averageMs() const { return m_samplesMs.empty() ? 0.0 : m_totalMs / m_samplesMs.size(); }
+	double framesPerSecond() const { return m_totalMs > 0.0 ? 1000.0 * m_samplesMs.size() / m_totalMs : 0.0; }
+
+	//percentile_ in [0, 100], nearest rank
+	double percentileMs(double percentile_) const;
+
+	void print(const std::string& label_) const;
+
+private:
+	std::vector<double> m_samplesMs;
+	double m_totalMs = 0.0;
+};
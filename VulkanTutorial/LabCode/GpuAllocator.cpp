@@ -0,0 +1,331 @@
+#include "GpuAllocator.h"
+
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+
+namespace {
+
+	uint32_t orderForSize(VkDeviceSize size_, VkDeviceSize minSize_)
+	{
+		uint32_t order = 0;
+		while ((minSize_ << order) < size_) {
+			order++;
+		}
+		return order;
+	}
+}
+
+double GpuAllocator::HeapStats::fragmentation() const
+{
+	return blockFreeBytes > 0 ? double(scatteredFreeBytes) / double(blockFreeBytes) : 0.0;
+}
+
+void GpuAllocator::create(VkDevice device_, VkPhysicalDevice physicalDevice_, const VkAllocationCallbacks* pAllocator_)
+{
+	m_device = device_;
+	m_pAllocator = pAllocator_;
+	vkGetPhysicalDeviceMemoryProperties(physicalDevice_, &m_memoryProperties);
+
+	//Blocks are at most an eighth of their heap, so small heaps (like 256 MB BAR memory) are not hogged by one block
+	m_pools.resize(m_memoryProperties.memoryTypeCount * 2);
+	m_dedicatedCounts.assign(m_memoryProperties.memoryTypeCount, 0);
+	m_dedicatedBytes.assign(m_memoryProperties.memoryTypeCount, 0);
+	for (uint32_t i = 0; i < m_pools.size(); i++) {
+		Pool& pool = m_pools[i];
+		pool.memoryTypeIndex = i / 2;
+
+		VkDeviceSize heapSize = m_memoryProperties.memoryHeaps[m_memoryProperties.memoryTypes[pool.memoryTypeIndex].heapIndex].size;
+		pool.blockSize = MIN_ALLOCATION_SIZE;
+		while (pool.blockSize * 2 <= std::min(MAX_BLOCK_SIZE, heapSize / 8)) {
+			pool.blockSize *= 2;
+		}
+		pool.maxOrder = orderForSize(pool.blockSize, MIN_ALLOCATION_SIZE);
+	}
+}
+
+void GpuAllocator::destroy()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	for (Pool& pool : m_pools) {
+		for (auto& block : pool.blocks) {
+			if (!block) {
+				continue;
+			}
+			if (block->allocationCount > 0) {
+				std::cerr << "gpu allocator: " << block->allocationCount << " allocations still alive in memory type "
+					<< pool.memoryTypeIndex << " [GpuAllocator::destroy]" << std::endl;
+			}
+			vkFreeMemory(m_device, block->memory, m_pAllocator);
+		}
+		pool.blocks.clear();
+	}
+	m_pools.clear();
+
+	for (uint32_t i = 0; i < m_dedicatedCounts.size(); i++) {
+		if (m_dedicatedCounts[i] > 0) {
+			std::cerr << "gpu allocator: " << m_dedicatedCounts[i] << " dedicated allocations still alive in memory type "
+				<< i << " [GpuAllocator::destroy]" << std::endl;
+		}
+	}
+}
+
+void GpuAllocator::allocate(const VkMemoryRequirements& requirements_, VkMemoryPropertyFlags properties_, ResourceKind kind_, GpuAllocation& allocation_)
+{
+	uint32_t memoryTypeIndex = findMemoryType(requirements_.memoryTypeBits, properties_);
+	uint32_t poolIndex = memoryTypeIndex * 2 + static_cast<uint32_t>(kind_);
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	Pool& pool = m_pools[poolIndex];
+
+	//1. Big resources would waste most of a block to rounding, give them their own memory
+	VkDeviceSize rangeSize = std::max(requirements_.size, requirements_.alignment);
+	uint32_t order = orderForSize(rangeSize, MIN_ALLOCATION_SIZE);
+	if (rangeSize > pool.blockSize / 2) {
+		allocateDedicated(requirements_.size, memoryTypeIndex, allocation_);
+		return;
+	}
+
+	//2. First block with a free range big enough, a new block otherwise
+	VkDeviceSize offset = 0;
+	uint32_t blockIndex = UINT32_MAX;
+	for (uint32_t i = 0; i < pool.blocks.size(); i++) {
+		if (pool.blocks[i] && allocateFromBlock(pool, *pool.blocks[i], order, offset)) {
+			blockIndex = i;
+			break;
+		}
+	}
+	if (blockIndex == UINT32_MAX) {
+		blockIndex = createBlock(pool);
+		allocateFromBlock(pool, *pool.blocks[blockIndex], order, offset);
+	}
+
+	Block& block = *pool.blocks[blockIndex];
+	block.usedBytes += MIN_ALLOCATION_SIZE << order;
+	block.requestedBytes += requirements_.size;
+	block.allocationCount++;
+
+	allocation_.memory = block.memory;
+	allocation_.offset = offset;
+	allocation_.size = requirements_.size;
+	allocation_.mapped = block.mapped ? static_cast<char*>(block.mapped) + offset : nullptr;
+	allocation_.memoryTypeIndex = memoryTypeIndex;
+	allocation_.poolIndex = poolIndex;
+	allocation_.blockIndex = blockIndex;
+	allocation_.order = order;
+}
+
+void GpuAllocator::free(GpuAllocation& allocation_)
+{
+	if (allocation_.memory == VK_NULL_HANDLE) {
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	if (allocation_.poolIndex == UINT32_MAX) {
+		vkFreeMemory(m_device, allocation_.memory, m_pAllocator);
+		m_dedicatedCounts[allocation_.memoryTypeIndex]--;
+		m_dedicatedBytes[allocation_.memoryTypeIndex] -= allocation_.size;
+		allocation_ = GpuAllocation();
+		return;
+	}
+
+	Pool& pool = m_pools[allocation_.poolIndex];
+	Block& block = *pool.blocks[allocation_.blockIndex];
+
+	//Merge with the buddy for as long as it is free as well
+	VkDeviceSize offset = allocation_.offset;
+	uint32_t order = allocation_.order;
+	while (order < pool.maxOrder) {
+		VkDeviceSize buddy = offset ^ (MIN_ALLOCATION_SIZE << order);
+		auto it = block.freeLists[order].find(buddy);
+		if (it == block.freeLists[order].end()) {
+			break;
+		}
+		block.freeLists[order].erase(it);
+		offset = std::min(offset, buddy);
+		order++;
+	}
+	block.freeLists[order].insert(offset);
+
+	block.usedBytes -= MIN_ALLOCATION_SIZE << allocation_.order;
+	block.requestedBytes -= allocation_.size;
+	block.allocationCount--;
+
+	//Keep one empty block around so alternating allocate/free does not thrash vkAllocateMemory
+	if (block.allocationCount == 0) {
+		size_t liveBlocks = std::count_if(pool.blocks.begin(), pool.blocks.end(), [](const std::unique_ptr<Block>& block_) { return block_ != nullptr; });
+		if (liveBlocks > 1) {
+			vkFreeMemory(m_device, block.memory, m_pAllocator);
+			pool.blocks[allocation_.blockIndex].reset();
+		}
+	}
+
+	allocation_ = GpuAllocation();
+}
+
+void GpuAllocator::allocateBufferMemory(VkBuffer buffer_, VkMemoryPropertyFlags properties_, GpuAllocation& allocation_)
+{
+	VkMemoryRequirements memRequirements;
+	vkGetBufferMemoryRequirements(m_device, buffer_, &memRequirements);
+
+	allocate(memRequirements, properties_, ResourceKind::Linear, allocation_);
+	vkBindBufferMemory(m_device, buffer_, allocation_.memory, allocation_.offset);
+}
+
+void GpuAllocator::allocateImageMemory(VkImage image_, VkImageTiling tiling_, VkMemoryPropertyFlags properties_, GpuAllocation& allocation_)
+{
+	VkMemoryRequirements memRequirements;
+	vkGetImageMemoryRequirements(m_device, image_, &memRequirements);
+
+	ResourceKind kind = tiling_ == VK_IMAGE_TILING_LINEAR ? ResourceKind::Linear : ResourceKind::Optimal;
+	allocate(memRequirements, properties_, kind, allocation_);
+	vkBindImageMemory(m_device, image_, allocation_.memory, allocation_.offset);
+}
+
+uint32_t GpuAllocator::findMemoryType(uint32_t typeFilter_, VkMemoryPropertyFlags properties_) const
+{
+	for (uint32_t i = 0; i < m_memoryProperties.memoryTypeCount; i++) {
+		if ((typeFilter_ & (1 << i)) && (m_memoryProperties.memoryTypes[i].propertyFlags & properties_) == properties_) {
+			return i;
+		}
+	}
+
+	throw std::runtime_error("failed to find suitable memory type! [GpuAllocator::findMemoryType]");
+}
+
+std::vector<GpuAllocator::HeapStats> GpuAllocator::heapStats() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	std::vector<HeapStats> stats(m_memoryProperties.memoryHeapCount);
+
+	for (const Pool& pool : m_pools) {
+		HeapStats& heap = stats[m_memoryProperties.memoryTypes[pool.memoryTypeIndex].heapIndex];
+
+		for (const auto& block : pool.blocks) {
+			if (!block) {
+				continue;
+			}
+			heap.reservedBytes += pool.blockSize;
+			heap.usedBytes += block->usedBytes;
+			heap.requestedBytes += block->requestedBytes;
+			heap.allocationCount += block->allocationCount;
+			heap.blockCount++;
+
+			VkDeviceSize freeBytes = pool.blockSize - block->usedBytes;
+			VkDeviceSize largestFree = 0;
+			for (uint32_t order = pool.maxOrder + 1; order-- > 0;) {
+				if (!block->freeLists[order].empty()) {
+					largestFree = MIN_ALLOCATION_SIZE << order;
+					break;
+				}
+			}
+			heap.largestFreeRange = std::max(heap.largestFreeRange, largestFree);
+			heap.blockFreeBytes += freeBytes;
+			heap.scatteredFreeBytes += freeBytes - largestFree;
+		}
+	}
+
+	for (uint32_t i = 0; i < m_dedicatedCounts.size(); i++) {
+		HeapStats& heap = stats[m_memoryProperties.memoryTypes[i].heapIndex];
+		heap.reservedBytes += m_dedicatedBytes[i];
+		heap.usedBytes += m_dedicatedBytes[i];
+		heap.requestedBytes += m_dedicatedBytes[i];
+		heap.allocationCount += m_dedicatedCounts[i];
+		heap.dedicatedCount += m_dedicatedCounts[i];
+	}
+
+	return stats;
+}
+
+void GpuAllocator::printStats() const
+{
+	std::vector<HeapStats> stats = heapStats();
+	for (size_t i = 0; i < stats.size(); i++) {
+		const HeapStats& heap = stats[i];
+		if (heap.reservedBytes == 0) {
+			continue;
+		}
+
+		std::cout << "gpu heap " << i << ": " << heap.allocationCount << " allocations in " << heap.blockCount << " blocks + "
+			<< heap.dedicatedCount << " dedicated, requested " << heap.requestedBytes / 1024 << " KB"
+			<< ", used " << heap.usedBytes / 1024 << " KB"
+			<< ", reserved " << heap.reservedBytes / 1024 << " KB"
+			<< ", fragmentation " << heap.fragmentation() * 100.0 << "%" << std::endl;
+	}
+}
+
+bool GpuAllocator::allocateFromBlock(Pool& pool_, Block& block_, uint32_t order_, VkDeviceSize& offset_)
+{
+	//Smallest free range which fits, split in halves until it has the requested order
+	uint32_t order = order_;
+	while (order <= pool_.maxOrder && block_.freeLists[order].empty()) {
+		order++;
+	}
+	if (order > pool_.maxOrder) {
+		return false;
+	}
+
+	VkDeviceSize offset = *block_.freeLists[order].begin();
+	block_.freeLists[order].erase(block_.freeLists[order].begin());
+
+	while (order > order_) {
+		order--;
+		block_.freeLists[order].insert(offset + (MIN_ALLOCATION_SIZE << order));
+	}
+
+	offset_ = offset;
+	return true;
+}
+
+uint32_t GpuAllocator::createBlock(Pool& pool_)
+{
+	auto block = std::make_unique<Block>();
+	block->memory = allocateDeviceMemory(pool_.blockSize, pool_.memoryTypeIndex, &block->mapped);
+	block->freeLists.resize(pool_.maxOrder + 1);
+	block->freeLists[pool_.maxOrder].insert(0);
+
+	for (uint32_t i = 0; i < pool_.blocks.size(); i++) {
+		if (!pool_.blocks[i]) {
+			pool_.blocks[i] = std::move(block);
+			return i;
+		}
+	}
+
+	pool_.blocks.push_back(std::move(block));
+	return static_cast<uint32_t>(pool_.blocks.size() - 1);
+}
+
+void GpuAllocator::allocateDedicated(VkDeviceSize size_, uint32_t memoryTypeIndex_, GpuAllocation& allocation_)
+{
+	allocation_ = GpuAllocation();
+	allocation_.memory = allocateDeviceMemory(size_, memoryTypeIndex_, &allocation_.mapped);
+	allocation_.size = size_;
+	allocation_.memoryTypeIndex = memoryTypeIndex_;
+
+	m_dedicatedCounts[memoryTypeIndex_]++;
+	m_dedicatedBytes[memoryTypeIndex_] += size_;
+}
+
+VkDeviceMemory GpuAllocator::allocateDeviceMemory(VkDeviceSize size_, uint32_t memoryTypeIndex_, void** mapped_)
+{
+	VkMemoryAllocateInfo allocInfo = {};
+	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	allocInfo.allocationSize = size_;
+	allocInfo.memoryTypeIndex = memoryTypeIndex_;
+
+	VkDeviceMemory memory;
+	if (vkAllocateMemory(m_device, &allocInfo, m_pAllocator, &memory) != VK_SUCCESS) {
+		throw std::runtime_error("failed to allocate device memory! [GpuAllocator::allocateDeviceMemory]");
+	}
+
+	//Host visible memory stays mapped for its whole lifetime, mapping is not free on every driver
+	*mapped_ = nullptr;
+	if (m_memoryProperties.memoryTypes[memoryTypeIndex_].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+		vkMapMemory(m_device, memory, 0, VK_WHOLE_SIZE, 0, mapped_);
+	}
+
+	return memory;
+}
@@ -0,0 +1,105 @@
+#pragma once
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <vector>
+
+//A sub range of a VkDeviceMemory handed out by GpuAllocator
+struct GpuAllocation {
+	VkDeviceMemory memory = VK_NULL_HANDLE;
+	VkDeviceSize offset = 0;
+	VkDeviceSize size = 0;
+
+	//Points at offset inside the block's persistent mapping, nullptr for memory which is not host visible
+	void* mapped = nullptr;
+
+	//Allocator bookkeeping
+	uint32_t memoryTypeIndex = 0;
+	uint32_t poolIndex = UINT32_MAX;	//UINT32_MAX for dedicated allocations
+	uint32_t blockIndex = 0;
+	uint32_t order = 0;
+};
+
+//Sub-allocates buffers and images out of large per memory type blocks instead of one vkAllocateMemory per resource.
+//Blocks are managed by a buddy allocator: every range is a power of two at an offset aligned to its own size,
+//so any alignment up to the range size is satisfied for free. Linear (buffers, linear images) and optimal resources
+//come from separate blocks, which keeps them bufferImageGranularity apart without tracking neighbours.
+//Resources bigger than half a block get a dedicated allocation.
+class GpuAllocator {
+public:
+	enum class ResourceKind { Linear, Optimal };
+
+	struct HeapStats {
+		VkDeviceSize reservedBytes = 0;		//Device memory held in blocks and dedicated allocations
+		VkDeviceSize usedBytes = 0;			//Bytes handed out, after power of two rounding
+		VkDeviceSize requestedBytes = 0;	//Bytes the resources asked for
+		VkDeviceSize largestFreeRange = 0;
+		VkDeviceSize blockFreeBytes = 0;		//Free bytes inside blocks
+		VkDeviceSize scatteredFreeBytes = 0;	//Free bytes outside of the largest free range of their block
+		uint32_t blockCount = 0;
+		uint32_t dedicatedCount = 0;
+		uint32_t allocationCount = 0;
+
+		//0 when the free space of every block is one range, approaching 1 when it is scattered
+		double fragmentation() const;
+	};
+
+	void create(VkDevice device_, VkPhysicalDevice physicalDevice_, const VkAllocationCallbacks* pAllocator_);
+	void destroy();
+
+	void allocate(const VkMemoryRequirements& requirements_, VkMemoryPropertyFlags properties_, ResourceKind kind_, GpuAllocation& allocation_);
+	void free(GpuAllocation& allocation_);
+
+	//Allocate and bind in one go
+	void allocateBufferMemory(VkBuffer buffer_, VkMemoryPropertyFlags properties_, GpuAllocation& allocation_);
+	void allocateImageMemory(VkImage image_, VkImageTiling tiling_, VkMemoryPropertyFlags properties_, GpuAllocation& allocation_);
+
+	uint32_t findMemoryType(uint32_t typeFilter_, VkMemoryPropertyFlags properties_) const;
+
+	std::vector<HeapStats> heapStats() const;
+	void printStats() const;
+
+private:
+	static const VkDeviceSize MIN_ALLOCATION_SIZE = 256;
+	static const VkDeviceSize MAX_BLOCK_SIZE = 64ull * 1024 * 1024;
+
+	struct Block {
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		void* mapped = nullptr;
+
+		//Free range offsets per order, order k ranges are MIN_ALLOCATION_SIZE << k bytes
+		std::vector<std::set<VkDeviceSize>> freeLists;
+		VkDeviceSize usedBytes = 0;
+		VkDeviceSize requestedBytes = 0;
+		uint32_t allocationCount = 0;
+	};
+
+	struct Pool {
+		uint32_t memoryTypeIndex = 0;
+		VkDeviceSize blockSize = 0;
+		uint32_t maxOrder = 0;
+
+		//Released blocks leave a nullptr behind so the indices of the others stay valid
+		std::vector<std::unique_ptr<Block>> blocks;
+	};
+
+	bool allocateFromBlock(Pool& pool_, Block& block_, uint32_t order_, VkDeviceSize& offset_);
+	uint32_t createBlock(Pool& pool_);
+	void allocateDedicated(VkDeviceSize size_, uint32_t memoryTypeIndex_, GpuAllocation& allocation_);
+	VkDeviceMemory allocateDeviceMemory(VkDeviceSize size_, uint32_t memoryTypeIndex_, void** mapped_);
+
+	VkDevice m_device = VK_NULL_HANDLE;
+	const VkAllocationCallbacks* m_pAllocator = nullptr;
+	VkPhysicalDeviceMemoryProperties m_memoryProperties = {};
+
+	//Two pools per memory type, index = memoryTypeIndex * 2 + ResourceKind
+	std::vector<Pool> m_pools;
+
+	//Dedicated allocations per memory type
+	std::vector<uint32_t> m_dedicatedCounts;
+	std::vector<VkDeviceSize> m_dedicatedBytes;
+	mutable std::mutex m_mutex;
+};
@@ -0,0 +1,211 @@
+#include "GpuProfiler.h"
+
+#include <iostream>
+#include <stdexcept>
+#include <algorithm>
+#include <cmath>
+
+void GpuProfiler::create(VkDevice device_, VkPhysicalDevice physicalDevice_, uint32_t queueFamilyIndex_, uint32_t slotCount_, const VkAllocationCallbacks* pAllocator_)
+{
+	m_device = device_;
+	m_pAllocator = pAllocator_;
+
+	//1. Check the queue can write timestamps at all and how many bits of them are meaningful
+	uint32_t queueFamilyCount = 0;
+	vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice_, &queueFamilyCount, nullptr);
+	std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+	vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice_, &queueFamilyCount, queueFamilies.data());
+
+	uint32_t validBits = queueFamilies[queueFamilyIndex_].timestampValidBits;
+	if (validBits == 0) {
+		std::cout << "gpu profiler: queue family " << queueFamilyIndex_ << " does not support timestamps, profiler disabled" << std::endl;
+		return;
+	}
+	m_timestampMask = validBits >= 64 ? ~0ull : ((1ull << validBits) - 1);
+
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(physicalDevice_, &properties);
+	m_timestampPeriodNs = properties.limits.timestampPeriod;
+
+	//2. One pool for all slots
+	m_slots.resize(slotCount_);
+	m_queryPool = createQueryPool(slotCount_);
+}
+
+VkQueryPool GpuProfiler::resize(uint32_t slotCount_)
+{
+	if (!isEnabled() || slotCount_ <= m_slots.size()) {
+		return VK_NULL_HANDLE;
+	}
+
+	VkQueryPool oldQueryPool = m_queryPool;
+	m_queryPool = createQueryPool(slotCount_);
+	m_slots.assign(slotCount_, Slot());
+	return oldQueryPool;
+}
+
+//Every scope uses a begin and an end query
+VkQueryPool GpuProfiler::createQueryPool(uint32_t slotCount_) const
+{
+	VkQueryPoolCreateInfo poolInfo = {};
+	poolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+	poolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+	poolInfo.queryCount = slotCount_ * MAX_SCOPES_PER_SLOT * 2;
+
+	VkQueryPool queryPool;
+	if (vkCreateQueryPool(m_device, &poolInfo, m_pAllocator, &queryPool) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create timestamp query pool! [GpuProfiler::createQueryPool]");
+	}
+	return queryPool;
+}
+
+void GpuProfiler::destroy()
+{
+	if (m_queryPool != VK_NULL_HANDLE) {
+		vkDestroyQueryPool(m_device, m_queryPool, m_pAllocator);
+		m_queryPool = VK_NULL_HANDLE;
+	}
+}
+
+void GpuProfiler::beginFrame(VkCommandBuffer commandBuffer_, uint32_t slot_)
+{
+	if (!isEnabled() || slot_ >= m_slots.size()) {
+		return;
+	}
+
+	m_slots[slot_].scopeNames.clear();
+	vkCmdResetQueryPool(commandBuffer_, m_queryPool, firstQuery(slot_), MAX_SCOPES_PER_SLOT * 2);
+}
+
+uint32_t GpuProfiler::beginScope(VkCommandBuffer commandBuffer_, uint32_t slot_, const std::string& name_)
+{
+	if (!isEnabled() || slot_ >= m_slots.size() || m_slots[slot_].scopeNames.size() >= MAX_SCOPES_PER_SLOT) {
+		return UINT32_MAX;
+	}
+
+	uint32_t scopeIndex = static_cast<uint32_t>(m_slots[slot_].scopeNames.size());
+	m_slots[slot_].scopeNames.push_back(name_);
+
+	vkCmdWriteTimestamp(commandBuffer_, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, m_queryPool, firstQuery(slot_) + scopeIndex * 2);
+	return scopeIndex;
+}
+
+void GpuProfiler::endScope(VkCommandBuffer commandBuffer_, uint32_t slot_, uint32_t scopeIndex_)
+{
+	if (!isEnabled() || slot_ >= m_slots.size() || scopeIndex_ == UINT32_MAX) {
+		return;
+	}
+
+	vkCmdWriteTimestamp(commandBuffer_, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, m_queryPool, firstQuery(slot_) + scopeIndex_ * 2 + 1);
+}
+
+void GpuProfiler::markSubmitted(uint32_t slot_)
+{
+	if (isEnabled() && slot_ < m_slots.size()) {
+		m_slots[slot_].pending = true;
+	}
+}
+
+void GpuProfiler::collect(uint32_t slot_)
+{
+	if (!isEnabled() || slot_ >= m_slots.size() || !m_slots[slot_].pending) {
+		return;
+	}
+
+	Slot& slot = m_slots[slot_];
+	uint32_t queryCount = static_cast<uint32_t>(slot.scopeNames.size()) * 2;
+	if (queryCount == 0) {
+		slot.pending = false;
+		return;
+	}
+
+	//Value and availability pairs, no WAIT flag so this never stalls the CPU.
+	//VK_NOT_READY still fills in every query which is available.
+	std::vector<uint64_t> results(queryCount * 2);
+	VkResult result = vkGetQueryPoolResults(m_device, m_queryPool, firstQuery(slot_), queryCount,
+		results.size() * sizeof(uint64_t), results.data(), 2 * sizeof(uint64_t),
+		VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+
+	if (result != VK_SUCCESS && result != VK_NOT_READY) {
+		return;
+	}
+
+	for (size_t i = 0; i < slot.scopeNames.size(); i++) {
+		const uint64_t* begin = &results[i * 4];
+		const uint64_t* end = &results[i * 4 + 2];
+		if (begin[1] == 0 || end[1] == 0) {
+			continue;
+		}
+
+		uint64_t ticks = ((end[0] & m_timestampMask) - (begin[0] & m_timestampMask)) & m_timestampMask;
+		addSample(slot.scopeNames[i], ticks * m_timestampPeriodNs / 1000000.0);
+	}
+
+	slot.pending = false;
+}
+
+bool GpuProfiler::getStats(const std::string& name_, ScopeStats& stats_) const
+{
+	auto it = m_history.find(name_);
+	if (it == m_history.end()) {
+		return false;
+	}
+
+	stats_ = computeStats(it->second);
+	return true;
+}
+
+std::map<std::string, GpuProfiler::ScopeStats> GpuProfiler::getAllStats() const
+{
+	std::map<std::string, ScopeStats> allStats;
+	for (const auto& entry : m_history) {
+		allStats[entry.first] = computeStats(entry.second);
+	}
+	return allStats;
+}
+
+void GpuProfiler::printStats() const
+{
+	for (const auto& entry : getAllStats()) {
+		std::cout << "gpu scope '" << entry.first << "': " << entry.second.samples << " samples"
+			<< ", min " << entry.second.minMs << " ms"
+			<< ", avg " << entry.second.avgMs << " ms"
+			<< ", p99 " << entry.second.p99Ms << " ms" << std::endl;
+	}
+}
+
+void GpuProfiler::addSample(const std::string& name_, double ms_)
+{
+	//Fixed size ring so the statistics follow the recent frames
+	History& history = m_history[name_];
+	if (history.samplesMs.size() < HISTORY_SIZE) {
+		history.samplesMs.push_back(ms_);
+	}
+	else {
+		history.samplesMs[history.next] = ms_;
+	}
+	history.next = (history.next + 1) % HISTORY_SIZE;
+}
+
+GpuProfiler::ScopeStats GpuProfiler::computeStats(const History& history_) const
+{
+	ScopeStats stats;
+	if (history_.samplesMs.empty()) {
+		return stats;
+	}
+
+	std::vector<double> sorted = history_.samplesMs;
+	std::sort(sorted.begin(), sorted.end());
+
+	double total = 0.0;
+	for (double sample : sorted) {
+		total += sample;
+	}
+
+	size_t p99Rank = static_cast<size_t>(std::ceil(0.99 * sorted.size()));
+	stats.samples = static_cast<uint32_t>(sorted.size());
+	stats.minMs = sorted.front();
+	stats.avgMs = total / sorted.size();
+	stats.p99Ms = sorted[std::min(sorted.size() - 1, p99Rank > 0 ? p99Rank - 1 : 0)];
+	return stats;
+}
@@ -0,0 +1,73 @@
+#pragma once
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <map>
+
+//Timestamp query based GPU profiler.
+//Queries are grouped in slots (one per frame in flight, or one per static command buffer). A slot's results
+//are read back without waiting the next time the slot is about to be reused, so they arrive one frame late.
+class GpuProfiler {
+public:
+	struct ScopeStats {
+		uint32_t samples = 0;
+		double minMs = 0.0;
+		double avgMs = 0.0;
+		double p99Ms = 0.0;
+	};
+
+	void create(VkDevice device_, VkPhysicalDevice physicalDevice_, uint32_t queueFamilyIndex_, uint32_t slotCount_, const VkAllocationCallbacks* pAllocator_);
+	void destroy();
+
+	bool isEnabled() const { return m_queryPool != VK_NULL_HANDLE; }
+	uint32_t slotCount() const { return static_cast<uint32_t>(m_slots.size()); }
+
+	//Grows the pool to slotCount_ slots, results not read back yet are dropped. Returns the replaced pool, which submitted
+	//command buffers may still write, for the caller to destroy once they have completed. VK_NULL_HANDLE if nothing changed.
+	VkQueryPool resize(uint32_t slotCount_);
+
+	//Recording, must be called outside of a render pass
+	void beginFrame(VkCommandBuffer commandBuffer_, uint32_t slot_);
+
+	//Returns a scope index for endScope(), scopes can be nested and opened anywhere after beginFrame()
+	uint32_t beginScope(VkCommandBuffer commandBuffer_, uint32_t slot_, const std::string& name_);
+	void endScope(VkCommandBuffer commandBuffer_, uint32_t slot_, uint32_t scopeIndex_);
+
+	//Submission bookkeeping and non blocking readback
+	void markSubmitted(uint32_t slot_);
+	void collect(uint32_t slot_);
+
+	bool getStats(const std::string& name_, ScopeStats& stats_) const;
+	std::map<std::string, ScopeStats> getAllStats() const;
+	void printStats() const;
+
+private:
+	static const uint32_t MAX_SCOPES_PER_SLOT = 32;
+	static const size_t HISTORY_SIZE = 512;
+
+	struct Slot {
+		std::vector<std::string> scopeNames;
+		bool pending = false;
+	};
+
+	struct History {
+		std::vector<double> samplesMs;
+		size_t next = 0;
+	};
+
+	uint32_t firstQuery(uint32_t slot_) const { return slot_ * MAX_SCOPES_PER_SLOT * 2; }
+	VkQueryPool createQueryPool(uint32_t slotCount_) const;
+	void addSample(const std::string& name_, double ms_);
+	ScopeStats computeStats(const History& history_) const;
+
+	VkDevice m_device = VK_NULL_HANDLE;
+	const VkAllocationCallbacks* m_pAllocator = nullptr;
+	VkQueryPool m_queryPool = VK_NULL_HANDLE;
+	double m_timestampPeriodNs = 1.0;
+	uint64_t m_timestampMask = ~0ull;
+
+	std::vector<Slot> m_slots;
+	std::map<std::string, History> m_history;
+};
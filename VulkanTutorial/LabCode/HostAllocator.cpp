@@ -0,0 +1,264 @@
+#include "HostAllocator.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+namespace {
+
+	const char* scopeName(uint32_t scope_)
+	{
+		switch (scope_) {
+		case VK_SYSTEM_ALLOCATION_SCOPE_COMMAND: return "command";
+		case VK_SYSTEM_ALLOCATION_SCOPE_OBJECT: return "object";
+		case VK_SYSTEM_ALLOCATION_SCOPE_CACHE: return "cache";
+		case VK_SYSTEM_ALLOCATION_SCOPE_DEVICE: return "device";
+		default: return "instance";
+		}
+	}
+
+	uintptr_t alignUp(uintptr_t value_, size_t alignment_)
+	{
+		return (value_ + alignment_ - 1) & ~uintptr_t(alignment_ - 1);
+	}
+}
+
+uint64_t HostAllocator::Counters::totalAllocations() const
+{
+	uint64_t total = 0;
+	for (const ScopeCounters& scope : scopes) {
+		total += scope.allocations + scope.reallocations;
+	}
+	return total;
+}
+
+uint64_t HostAllocator::Counters::totalBytes() const
+{
+	uint64_t total = internalBytes;
+	for (const ScopeCounters& scope : scopes) {
+		total += scope.liveBytes;
+	}
+	return total;
+}
+
+HostAllocator::HostAllocator()
+{
+	m_callbacks.pUserData = this;
+	m_callbacks.pfnAllocation = allocationCallback;
+	m_callbacks.pfnReallocation = reallocationCallback;
+	m_callbacks.pfnFree = freeCallback;
+	m_callbacks.pfnInternalAllocation = internalAllocationCallback;
+	m_callbacks.pfnInternalFree = internalFreeCallback;
+}
+
+HostAllocator::~HostAllocator()
+{
+	for (void* slab : m_slabs) {
+		std::free(slab);
+	}
+	std::free(m_arena);
+}
+
+HostAllocator::Counters HostAllocator::counters() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_counters;
+}
+
+void HostAllocator::printStats() const
+{
+	if (!m_enabled) {
+		return;
+	}
+
+	Counters counters = this->counters();
+	for (uint32_t i = 0; i < VK_SYSTEM_ALLOCATION_SCOPE_RANGE_SIZE; i++) {
+		const ScopeCounters& scope = counters.scopes[i];
+		if (scope.allocations == 0) {
+			continue;
+		}
+
+		std::cout << "host allocations, " << scopeName(i) << " scope: " << scope.allocations << " allocations, "
+			<< scope.reallocations << " reallocations, " << scope.frees << " frees, "
+			<< scope.liveBytes / 1024 << " KB live, " << scope.peakBytes / 1024 << " KB peak" << std::endl;
+	}
+	if (counters.internalBytes > 0) {
+		std::cout << "host allocations, driver internal: " << counters.internalBytes / 1024 << " KB live" << std::endl;
+	}
+}
+
+VKAPI_ATTR void* VKAPI_CALL HostAllocator::allocationCallback(void* pUserData_, size_t size_, size_t alignment_, VkSystemAllocationScope scope_)
+{
+	return static_cast<HostAllocator*>(pUserData_)->allocate(size_, alignment_, scope_);
+}
+
+VKAPI_ATTR void* VKAPI_CALL HostAllocator::reallocationCallback(void* pUserData_, void* pOriginal_, size_t size_, size_t alignment_, VkSystemAllocationScope scope_)
+{
+	HostAllocator* allocator = static_cast<HostAllocator*>(pUserData_);
+
+	if (!pOriginal_) {
+		return allocator->allocate(size_, alignment_, scope_);
+	}
+	if (size_ == 0) {
+		allocator->free(pOriginal_);
+		return nullptr;
+	}
+
+	//Slots and arena ranges cannot grow in place, always move. Counted as one reallocation instead of an allocation and a free.
+	uint32_t originalScope = headerOf(pOriginal_)->scope;
+	void* memory = allocator->allocate(size_, alignment_, scope_);
+	if (memory) {
+		memcpy(memory, pOriginal_, std::min(size_, headerOf(pOriginal_)->size));
+		allocator->free(pOriginal_);
+
+		std::lock_guard<std::mutex> lock(allocator->m_mutex);
+		allocator->m_counters.scopes[scope_].allocations--;
+		allocator->m_counters.scopes[scope_].reallocations++;
+		allocator->m_counters.scopes[originalScope].frees--;
+	}
+	return memory;
+}
+
+VKAPI_ATTR void VKAPI_CALL HostAllocator::freeCallback(void* pUserData_, void* pMemory_)
+{
+	static_cast<HostAllocator*>(pUserData_)->free(pMemory_);
+}
+
+VKAPI_ATTR void VKAPI_CALL HostAllocator::internalAllocationCallback(void* pUserData_, size_t size_, VkInternalAllocationType /*type_*/, VkSystemAllocationScope /*scope_*/)
+{
+	HostAllocator* allocator = static_cast<HostAllocator*>(pUserData_);
+	std::lock_guard<std::mutex> lock(allocator->m_mutex);
+	allocator->m_counters.internalBytes += size_;
+}
+
+VKAPI_ATTR void VKAPI_CALL HostAllocator::internalFreeCallback(void* pUserData_, size_t size_, VkInternalAllocationType /*type_*/, VkSystemAllocationScope /*scope_*/)
+{
+	HostAllocator* allocator = static_cast<HostAllocator*>(pUserData_);
+	std::lock_guard<std::mutex> lock(allocator->m_mutex);
+	allocator->m_counters.internalBytes -= size_;
+}
+
+void* HostAllocator::allocate(size_t size_, size_t alignment_, VkSystemAllocationScope scope_)
+{
+	if (size_ == 0) {
+		return nullptr;
+	}
+
+	alignment_ = std::max(alignment_, alignof(Header));
+	size_t required = size_ + sizeof(Header) + alignment_ - 1;
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	//1. Pick where the memory comes from, the arena only takes what fits without a new chunk
+	void* base = nullptr;
+	uint32_t source = SOURCE_LARGE;
+
+	if (scope_ == VK_SYSTEM_ALLOCATION_SCOPE_COMMAND) {
+		base = allocateFromArena(required);
+		source = SOURCE_ARENA;
+	}
+	if (!base) {
+		uint32_t sizeClass = 0;
+		while (sizeClass < SIZE_CLASS_COUNT && (MIN_SIZE_CLASS << sizeClass) < required) {
+			sizeClass++;
+		}
+
+		if (sizeClass < SIZE_CLASS_COUNT) {
+			base = allocateFromSizeClass(sizeClass);
+			source = sizeClass;
+		}
+		else {
+			base = std::malloc(required);
+			source = SOURCE_LARGE;
+		}
+	}
+	if (!base) {
+		return nullptr;
+	}
+
+	//2. Header goes right in front of the aligned pointer
+	char* memory = reinterpret_cast<char*>(alignUp(reinterpret_cast<uintptr_t>(base) + sizeof(Header), alignment_));
+	Header* header = headerOf(memory);
+	header->base = base;
+	header->source = source;
+	header->scope = scope_;
+	header->size = size_;
+
+	ScopeCounters& counters = m_counters.scopes[scope_];
+	counters.allocations++;
+	counters.liveBytes += size_;
+	counters.peakBytes = std::max(counters.peakBytes, counters.liveBytes);
+
+	return memory;
+}
+
+void HostAllocator::free(void* pMemory_)
+{
+	if (!pMemory_) {
+		return;
+	}
+
+	Header* header = headerOf(pMemory_);
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	ScopeCounters& counters = m_counters.scopes[header->scope];
+	counters.frees++;
+	counters.liveBytes -= header->size;
+
+	if (header->source == SOURCE_ARENA) {
+		//Ranges are never reused individually, the whole arena is rewound once the last one is gone
+		if (--m_arenaLiveCount == 0) {
+			m_arenaOffset = 0;
+		}
+	}
+	else if (header->source == SOURCE_LARGE) {
+		std::free(header->base);
+	}
+	else {
+		m_freeSlots[header->source].push_back(header->base);
+	}
+}
+
+void* HostAllocator::allocateFromSizeClass(uint32_t sizeClass_)
+{
+	std::vector<void*>& freeSlots = m_freeSlots[sizeClass_];
+
+	//Cut a new slab into slots of this class when the free list runs dry
+	if (freeSlots.empty()) {
+		char* slab = static_cast<char*>(std::malloc(SLAB_SIZE));
+		if (!slab) {
+			return nullptr;
+		}
+		m_slabs.push_back(slab);
+
+		size_t slotSize = MIN_SIZE_CLASS << sizeClass_;
+		for (size_t offset = SLAB_SIZE; offset >= slotSize; offset -= slotSize) {
+			freeSlots.push_back(slab + offset - slotSize);
+		}
+	}
+
+	void* slot = freeSlots.back();
+	freeSlots.pop_back();
+	return slot;
+}
+
+void* HostAllocator::allocateFromArena(size_t size_)
+{
+	if (!m_arena) {
+		m_arena = static_cast<char*>(std::malloc(COMMAND_ARENA_SIZE));
+		if (!m_arena) {
+			return nullptr;
+		}
+	}
+
+	if (m_arenaOffset + size_ > COMMAND_ARENA_SIZE) {
+		return nullptr;
+	}
+
+	void* memory = m_arena + m_arenaOffset;
+	m_arenaOffset = alignUp(m_arenaOffset + size_, alignof(Header));
+	m_arenaLiveCount++;
+	return memory;
+}
@@ -0,0 +1,88 @@
+#pragma once
+#include <vulkan/vulkan.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+//VkAllocationCallbacks implementation for the driver's host side allocations.
+//Small allocations are served from power of two size classes carved out of 64 KB slabs, VK_SYSTEM_ALLOCATION_SCOPE_COMMAND
+//allocations (which only live for the duration of one Vulkan call) come from a linear arena that is rewound once all of
+//them are freed again. Everything is counted per allocation scope so churn can be measured around specific calls.
+class HostAllocator {
+public:
+	struct ScopeCounters {
+		uint64_t allocations = 0;
+		uint64_t reallocations = 0;
+		uint64_t frees = 0;
+		uint64_t liveBytes = 0;
+		uint64_t peakBytes = 0;
+	};
+
+	struct Counters {
+		ScopeCounters scopes[VK_SYSTEM_ALLOCATION_SCOPE_RANGE_SIZE];
+		uint64_t internalBytes = 0;	//Reported through the internal allocation notifications
+
+		uint64_t totalAllocations() const;
+		uint64_t totalBytes() const;
+	};
+
+	HostAllocator();
+	~HostAllocator();
+
+	HostAllocator(const HostAllocator&) = delete;
+	HostAllocator& operator=(const HostAllocator&) = delete;
+
+	//nullptr until enabled, so callers can pass callbacks() straight to every vkCreate* and vkDestroy* call.
+	//Must be called before the first Vulkan object is created and never changed afterwards.
+	void setEnabled(bool enabled_) { m_enabled = enabled_; }
+	const VkAllocationCallbacks* callbacks() const { return m_enabled ? &m_callbacks : nullptr; }
+
+	Counters counters() const;
+	void printStats() const;
+
+private:
+	static const uint32_t SIZE_CLASS_COUNT = 9;			//16 B up to 4 KB
+	static const size_t MIN_SIZE_CLASS = 16;
+	static const size_t SLAB_SIZE = 64 * 1024;
+	static const size_t COMMAND_ARENA_SIZE = 256 * 1024;
+
+	//Stored right in front of every pointer handed out
+	struct Header {
+		void* base;			//Start of the slot, arena range or malloc block
+		uint32_t source;	//Size class index, LARGE or ARENA
+		uint32_t scope;
+		size_t size;		//Requested size
+	};
+	static const uint32_t SOURCE_LARGE = 0xFFFFFFFE;
+	static const uint32_t SOURCE_ARENA = 0xFFFFFFFF;
+
+	static VKAPI_ATTR void* VKAPI_CALL allocationCallback(void* pUserData_, size_t size_, size_t alignment_, VkSystemAllocationScope scope_);
+	static VKAPI_ATTR void* VKAPI_CALL reallocationCallback(void* pUserData_, void* pOriginal_, size_t size_, size_t alignment_, VkSystemAllocationScope scope_);
+	static VKAPI_ATTR void VKAPI_CALL freeCallback(void* pUserData_, void* pMemory_);
+	static VKAPI_ATTR void VKAPI_CALL internalAllocationCallback(void* pUserData_, size_t size_, VkInternalAllocationType type_, VkSystemAllocationScope scope_);
+	static VKAPI_ATTR void VKAPI_CALL internalFreeCallback(void* pUserData_, size_t size_, VkInternalAllocationType type_, VkSystemAllocationScope scope_);
+
+	void* allocate(size_t size_, size_t alignment_, VkSystemAllocationScope scope_);
+	void free(void* pMemory_);
+
+	//Lock must be held
+	void* allocateFromSizeClass(uint32_t sizeClass_);
+	void* allocateFromArena(size_t size_);
+	static Header* headerOf(void* pMemory_) { return reinterpret_cast<Header*>(static_cast<char*>(pMemory_) - sizeof(Header)); }
+
+	VkAllocationCallbacks m_callbacks = {};
+	bool m_enabled = false;
+
+	mutable std::mutex m_mutex;
+	std::vector<void*> m_freeSlots[SIZE_CLASS_COUNT];
+	std::vector<void*> m_slabs;
+
+	//Linear arena for command scope allocations
+	char* m_arena = nullptr;
+	size_t m_arenaOffset = 0;
+	uint32_t m_arenaLiveCount = 0;
+
+	Counters m_counters;
+};
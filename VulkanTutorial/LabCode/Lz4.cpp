@@ -0,0 +1,187 @@
+#include "Lz4.h"
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace {
+
+	const size_t MIN_MATCH = 4;
+	const size_t LAST_LITERALS = 5;		//The block always ends with at least this many literals
+	const size_t MATCH_FIND_LIMIT = 12;	//No match may start closer than this to the end of the block
+	const size_t MAX_OFFSET = 65535;
+	const uint32_t HASH_BITS = 12;
+
+	uint32_t read32(const char* p_)
+	{
+		uint32_t value;
+		memcpy(&value, p_, sizeof(value));
+		return value;
+	}
+
+	uint32_t hashSequence(uint32_t sequence_)
+	{
+		return (sequence_ * 2654435761u) >> (32 - HASH_BITS);
+	}
+
+	//Appends one sequence: literals, then a match unless matchLength_ is 0 (the last sequence)
+	bool emitSequence(const char* literals_, size_t literalLength_, size_t offset_, size_t matchLength_, char* dst_, size_t dstCapacity_, size_t& dstSize_)
+	{
+		size_t needed = 1 + literalLength_ / 255 + 1 + literalLength_ + (matchLength_ > 0 ? 2 + matchLength_ / 255 + 1 : 0);
+		if (needed > dstCapacity_ - dstSize_) {
+			return false;
+		}
+
+		unsigned char* out = reinterpret_cast<unsigned char*>(dst_ + dstSize_);
+		unsigned char* token = out++;
+
+		*token = static_cast<unsigned char>((literalLength_ >= 15 ? 15 : literalLength_) << 4);
+		if (literalLength_ >= 15) {
+			size_t remaining = literalLength_ - 15;
+			for (; remaining >= 255; remaining -= 255) {
+				*out++ = 255;
+			}
+			*out++ = static_cast<unsigned char>(remaining);
+		}
+
+		if (literalLength_ > 0) {
+			memcpy(out, literals_, literalLength_);
+			out += literalLength_;
+		}
+
+		if (matchLength_ > 0) {
+			*out++ = static_cast<unsigned char>(offset_ & 0xff);
+			*out++ = static_cast<unsigned char>(offset_ >> 8);
+
+			size_t extraLength = matchLength_ - MIN_MATCH;
+			*token |= static_cast<unsigned char>(extraLength >= 15 ? 15 : extraLength);
+			if (extraLength >= 15) {
+				size_t remaining = extraLength - 15;
+				for (; remaining >= 255; remaining -= 255) {
+					*out++ = 255;
+				}
+				*out++ = static_cast<unsigned char>(remaining);
+			}
+		}
+
+		dstSize_ = reinterpret_cast<char*>(out) - dst_;
+		return true;
+	}
+
+	//Reads the 255 terminated continuation of a 15 length nibble
+	bool readLength(const unsigned char* src_, size_t srcSize_, size_t& position_, size_t& length_)
+	{
+		unsigned char byte;
+		do {
+			if (position_ >= srcSize_) {
+				return false;
+			}
+			byte = src_[position_++];
+			length_ += byte;
+		} while (byte == 255);
+		return true;
+	}
+}
+
+size_t Lz4::compressBound(size_t srcSize_)
+{
+	return srcSize_ + srcSize_ / 255 + 16;
+}
+
+size_t Lz4::compress(const char* src_, size_t srcSize_, char* dst_, size_t dstCapacity_)
+{
+	//Positions are stored plus one, so zero marks an empty slot
+	std::vector<uint32_t> table(size_t(1) << HASH_BITS, 0);
+
+	size_t dstSize = 0;
+	size_t position = 0;
+	size_t anchor = 0;
+	size_t matchLimit = srcSize_ > LAST_LITERALS ? srcSize_ - LAST_LITERALS : 0;
+
+	while (position + MATCH_FIND_LIMIT <= srcSize_) {
+		uint32_t sequence = read32(src_ + position);
+		uint32_t& slot = table[hashSequence(sequence)];
+		size_t candidate = slot;
+		slot = static_cast<uint32_t>(position + 1);
+
+		if (candidate == 0 || position - (candidate - 1) > MAX_OFFSET || read32(src_ + candidate - 1) != sequence) {
+			position++;
+			continue;
+		}
+
+		size_t reference = candidate - 1;
+		size_t matchLength = MIN_MATCH;
+		while (position + matchLength < matchLimit && src_[reference + matchLength] == src_[position + matchLength]) {
+			matchLength++;
+		}
+
+		if (!emitSequence(src_ + anchor, position - anchor, position - reference, matchLength, dst_, dstCapacity_, dstSize)) {
+			return 0;
+		}
+
+		position += matchLength;
+		anchor = position;
+	}
+
+	if (!emitSequence(src_ + anchor, srcSize_ - anchor, 0, 0, dst_, dstCapacity_, dstSize)) {
+		return 0;
+	}
+	return dstSize;
+}
+
+bool Lz4::decompress(const char* src_, size_t srcSize_, char* dst_, size_t dstSize_)
+{
+	const unsigned char* src = reinterpret_cast<const unsigned char*>(src_);
+	size_t position = 0;
+	size_t written = 0;
+
+	while (position < srcSize_) {
+		unsigned char token = src[position++];
+
+		//1. Literals
+		size_t literalLength = token >> 4;
+		if (literalLength == 15 && !readLength(src, srcSize_, position, literalLength)) {
+			return false;
+		}
+		if (literalLength > srcSize_ - position || literalLength > dstSize_ - written) {
+			return false;
+		}
+		if (literalLength > 0) {
+			memcpy(dst_ + written, src + position, literalLength);
+		}
+		position += literalLength;
+		written += literalLength;
+
+		//The last sequence has no match
+		if (position == srcSize_) {
+			break;
+		}
+
+		//2. Match, which may overlap the bytes it produces
+		if (srcSize_ - position < 2) {
+			return false;
+		}
+		size_t offset = src[position] | (size_t(src[position + 1]) << 8);
+		position += 2;
+		if (offset == 0 || offset > written) {
+			return false;
+		}
+
+		size_t matchLength = token & 15;
+		if (matchLength == 15 && !readLength(src, srcSize_, position, matchLength)) {
+			return false;
+		}
+		matchLength += MIN_MATCH;
+		if (matchLength > dstSize_ - written) {
+			return false;
+		}
+
+		const char* match = dst_ + written - offset;
+		for (size_t i = 0; i < matchLength; i++) {
+			dst_[written + i] = match[i];
+		}
+		written += matchLength;
+	}
+
+	return written == dstSize_;
+}
@@ -0,0 +1,16 @@
+#pragma once
+#include <cstddef>
+
+//LZ4 block format (no frame, no checksums), compatible with LZ4_compress_default / LZ4_decompress_safe.
+//Greedy single probe matcher: compresses a little worse than the reference, decompresses at the same speed.
+namespace Lz4 {
+
+	//Worst case compressed size of srcSize_ bytes
+	size_t compressBound(size_t srcSize_);
+
+	//Returns the compressed size, or 0 if the result does not fit into dstCapacity_
+	size_t compress(const char* src_, size_t srcSize_, char* dst_, size_t dstCapacity_);
+
+	//Returns false on malformed input or if the block does not decompress to exactly dstSize_ bytes
+	bool decompress(const char* src_, size_t srcSize_, char* dst_, size_t dstSize_);
+}
@@ -5,18 +5,57 @@
 #include <stdexcept>
 #include <functional>
 #include <cstdlib>
+#include <cerrno>
 #include <vector>
 #include <algorithm>
 #include <optional>
 #include <set>
 #include <cstdint> //Necessary for UINT32_MAX
-#include <fstream>
+#include <cstring>
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <string>
+#include <filesystem>
+#include <cmath>
+#include <atomic>
+
+#include "PipelineCache.h"
+#include "ThreadPool.h"
+#include "FrameStats.h"
+#include "GpuProfiler.h"
+#include "CpuTrace.h"
+#include "DebugMessageSink.h"
+#include "Vertex.h"
+#include "GpuAllocator.h"
+#include "HostAllocator.h"
+#include "ShaderCompiler.h"
+#include "FileWatcher.h"
+#include "PipelineCompiler.h"
+#include "AssetArchive.h"
+#include "RenderGraph.h"
+#include "UniformRing.h"
+#include "DescriptorAllocator.h"
+#include "BindlessTable.h"
 
 const int WIDTH = 800;
 const int HEIGHT = 600;
 
 const int MAX_FRAMES_IN_FLIGHT = 2;
 
+//Upper bounds of the bindless arrays, the device limits may lower them
+const uint32_t BINDLESS_STORAGE_BUFFERS = 1024;
+const uint32_t BINDLESS_SAMPLED_IMAGES = 16384;
+
+//Pipeline cache blob, loaded at startup and written back at shutdown
+const char* PIPELINE_CACHE_FILE = "pipeline_cache.bin";
+
+//Picks the physical device by index or by a part of its name, instead of the highest scoring one
+const char* DEVICE_OVERRIDE_VARIABLE = "LAB_DEVICE";
+
+//Compiled SPIR-V keyed by a hash of the GLSL source, includes, defines and compile options
+const char* SHADER_CACHE_DIRECTORY = "shader_cache";
+
 const std::vector<const char*> validationLayers = {
 	"VK_LAYER_KHRONOS_validation"
 };
@@ -31,24 +70,6 @@ const std::vector<const char*> deviceExtensions = {
 	VK_KHR_SWAPCHAIN_EXTENSION_NAME
 };
 
-static std::vector<char> readFile(const std::string& filename_) {
-	std::ifstream file(filename_, std::ios::ate | std::ios::binary);
-
-	if (!file.is_open()) {
-		throw std::runtime_error("failed to open file!");
-	}
-
-	size_t fileSize = (size_t)file.tellg();
-	std::vector<char> buffer(fileSize);
-
-	file.seekg(0);
-	file.read(buffer.data(), fileSize);
-
-	file.close();
-
-	return buffer;
-}
-
 //Wrapper Function to create DebugUtilsMessenger
 VkResult CreateDebugUtilsMessengerEXT(VkInstance instance,
 	const VkDebugUtilsMessengerCreateInfoEXT* pCreateInfo_,
@@ -70,17 +91,301 @@ void DestroyDebugUtilsMessengerEXT(VkInstance instance, VkDebugUtilsMessengerEXT
 		func(instance, debugMessenger, pAllocator);
 	}
 }
+struct AppOptions {
+	//Re-record one command buffer per frame in flight instead of replaying one static buffer per swap chain image
+	bool recordPerFrame = false;
+
+	//Worker threads recording secondary command buffers, 0 records everything on the main thread
+	uint32_t threadCount = 0;
+
+	//Number of triangle draws recorded per frame
+	uint32_t drawCount = 1;
+
+	//Measure CPU frame time for an increasing number of recording threads, then exit
+	bool benchmarkThreads = false;
+
+	//Pace frames with one VK_KHR_timeline_semaphore counter instead of per frame fences
+	bool timelineSemaphores = false;
+
+	//Read per draw data through one VK_EXT_descriptor_indexing set indexed with push constants, no per draw binds
+	bool bindless = false;
+
+	//Draw the quads as instances of one mesh in a single draw call, their data comes from a per instance vertex stream
+	bool instanced = false;
+
+	//Render a million triangle instances headless with one instanced draw and with one draw per object, then exit
+	bool benchmarkInstancing = false;
+
+	//Number of frames the CPU may record ahead of the GPU
+	uint32_t framesInFlight = MAX_FRAMES_IN_FLIGHT;
+
+	//Render into a ring of offscreen images without GLFW, a surface or a swap chain
+	bool headless = false;
+
+	//Stop after this many frames, 0 runs until the window is closed
+	uint32_t frameCount = 0;
+
+	//Bracket GPU work with timestamp queries and report per scope timings at exit
+	bool profileGpu = false;
+
+	//Record CPU scopes and write them as a Chrome trace to this file at exit, empty disables tracing
+	std::string traceFile;
+
+	//Validation messages which are printed, and at most how many lines per second (0 for no limit)
+	VkDebugUtilsMessageSeverityFlagsEXT debugSeverityMask = DebugMessageSink::severityMaskFromName("warning");
+	VkDebugUtilsMessageTypeFlagsEXT debugTypeMask = DebugMessageSink::typeMaskFromList("general,validation,performance");
+	uint32_t debugLinesPerSecond = 20;
+
+	//Measure staging buffer upload throughput for a range of sizes, then exit
+	bool benchmarkUpload = false;
+
+	//Measure the CPU cost per draw of uniform ring pushes against a descriptor set per draw, then exit
+	bool benchmarkUniforms = false;
+
+	//Measure allocation and free rates of the GPU memory sub-allocator against plain vkAllocateMemory, then exit
+	bool benchmarkAllocator = false;
+
+	//Route the driver's host allocations through HostAllocator and report them per allocation scope
+	bool hostAllocator = false;
+
+	//Watch the shader sources and rebuild the graphics pipeline in the background when one of them changes
+	bool hotReload = false;
+
+	//Build the graphics pipeline on a worker thread, frames are recorded without draws until it is ready
+	bool asyncPipelines = false;
+
+	//Build the frame with the render graph: the scene goes into a transient target, is softened by a half resolution
+	//down and up sample and blitted into the swap chain image
+	bool renderGraph = false;
+
+	//Serve shaders from this archive instead of the shader cache and loose files, edits to them are not hot reloaded
+	std::string archiveFile;
+
+	//Pack every file below packDirectory into packArchive, then exit without starting Vulkan
+	std::string packArchive;
+	std::string packDirectory;
+};
+
+static AppOptions parseOptions(int argc, char** argv) {
+	AppOptions options;
+
+	bool drawCountSet = false;
+
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+
+		auto nextString = [&]() -> std::string {
+			if (i + 1 >= argc) {
+				throw std::runtime_error("missing value for option '" + arg + "' [::parseOptions]");
+			}
+			return argv[++i];
+		};
+		auto nextValue = [&]() -> uint32_t {
+			return static_cast<uint32_t>(std::stoul(nextString()));
+		};
+
+		if (arg == "--record-per-frame") {
+			options.recordPerFrame = true;
+		}
+		else if (arg == "--threads") {
+			options.threadCount = nextValue();
+		}
+		else if (arg == "--draws") {
+			options.drawCount = nextValue();
+			drawCountSet = true;
+		}
+		else if (arg == "--bench-threads") {
+			options.benchmarkThreads = true;
+		}
+		else if (arg == "--timeline") {
+			options.timelineSemaphores = true;
+		}
+		else if (arg == "--bindless") {
+			options.bindless = true;
+		}
+		else if (arg == "--instanced") {
+			options.instanced = true;
+		}
+		else if (arg == "--bench-instancing") {
+			options.benchmarkInstancing = true;
+		}
+		else if (arg == "--frames-in-flight") {
+			options.framesInFlight = std::max(1u, nextValue());
+		}
+		else if (arg == "--headless") {
+			options.headless = true;
+		}
+		else if (arg == "--frames") {
+			options.frameCount = nextValue();
+		}
+		else if (arg == "--profile-gpu") {
+			options.profileGpu = true;
+		}
+		else if (arg == "--trace") {
+			options.traceFile = nextString();
+		}
+		else if (arg == "--debug-severity") {
+			options.debugSeverityMask = DebugMessageSink::severityMaskFromName(nextString());
+		}
+		else if (arg == "--debug-types") {
+			options.debugTypeMask = DebugMessageSink::typeMaskFromList(nextString());
+		}
+		else if (arg == "--debug-rate") {
+			options.debugLinesPerSecond = nextValue();
+		}
+		else if (arg == "--bench-upload") {
+			options.benchmarkUpload = true;
+		}
+		else if (arg == "--bench-uniforms") {
+			options.benchmarkUniforms = true;
+		}
+		else if (arg == "--bench-alloc") {
+			options.benchmarkAllocator = true;
+		}
+		else if (arg == "--host-allocator") {
+			options.hostAllocator = true;
+		}
+		else if (arg == "--hot-reload") {
+			options.hotReload = true;
+		}
+		else if (arg == "--async-pipelines") {
+			options.asyncPipelines = true;
+		}
+		else if (arg == "--render-graph") {
+			options.renderGraph = true;
+		}
+		else if (arg == "--archive") {
+			options.archiveFile = nextString();
+		}
+		else if (arg == "--pack") {
+			options.packArchive = nextString();
+			options.packDirectory = nextString();
+		}
+		else {
+			throw std::runtime_error("unknown option '" + arg + "' [::parseOptions]");
+		}
+	}
+
+	//Worker command pools belong to a frame in flight, so threaded recording implies per frame recording
+	if (options.threadCount > 0 || options.benchmarkThreads) {
+		options.recordPerFrame = true;
+	}
+
+	//A reloaded or late pipeline is picked up by the next recorded frame, static command buffers would keep the old one
+	if (options.hotReload || options.asyncPipelines) {
+		options.recordPerFrame = true;
+	}
+
+	//Without a window there is nothing to close, so headless runs are always bounded
+	if (options.headless && options.frameCount == 0) {
+		options.frameCount = 1000;
+	}
+
+	//Give the scaling benchmark enough draws to be CPU bound on recording
+	if (options.benchmarkThreads && !drawCountSet) {
+		options.drawCount = 20000;
+	}
+
+	//The instancing benchmark switches between both draw paths from one frame to the next, without presenting
+	if (options.benchmarkInstancing) {
+		options.instanced = true;
+		options.headless = true;
+		options.recordPerFrame = true;
+		if (!drawCountSet) {
+			options.drawCount = 1000000;
+		}
+	}
+
+	//Instances carry their data in the vertex stream, the bindless table would have nothing to provide
+	if (options.instanced) {
+		options.bindless = false;
+	}
+
+	return options;
+}
+
+static std::string readEnvironmentVariable(const char* name_) {
+#ifdef _MSC_VER
+	//getenv is deprecated under /sdl
+	char* value = nullptr;
+	size_t length = 0;
+	if (_dupenv_s(&value, &length, name_) != 0 || value == nullptr) {
+		return {};
+	}
+	std::string result(value);
+	free(value);
+	return result;
+#else
+	const char* value = std::getenv(name_);
+	return value ? value : "";
+#endif
+}
+
+//Offline packer, one archive entry per file below directory_ named by its path relative to directory_
+static void packDirectory(const std::string& archivePath_, const std::string& directory_) {
+	std::vector<AssetArchive::PackEntry> entries;
+	for (const auto& file : std::filesystem::recursive_directory_iterator(directory_)) {
+		if (!file.is_regular_file()) {
+			continue;
+		}
+
+		//Packing into the input directory must not swallow the previous archive
+		std::error_code error;
+		if (std::filesystem::equivalent(file.path(), archivePath_, error)) {
+			continue;
+		}
+
+		entries.push_back({ std::filesystem::relative(file.path(), directory_).generic_string(), file.path().string() });
+	}
+
+	//Iteration order is unspecified, sorting makes the archive reproducible
+	std::sort(entries.begin(), entries.end(), [](const AssetArchive::PackEntry& a_, const AssetArchive::PackEntry& b_) {
+		return a_.name < b_.name;
+	});
+
+	AssetArchive::PackStats stats = AssetArchive::pack(archivePath_, entries, true);
+	std::cout << "packed " << stats.entries << " files from '" << directory_ << "' into '" << archivePath_ << "': "
+		<< stats.rawBytes << " bytes, " << stats.storedBytes << " stored, " << stats.compressed << " entries compressed, "
+		<< stats.archiveBytes << " bytes on disk" << std::endl;
+}
+
 class HelloTriangleApplication {
 public:
+	explicit HelloTriangleApplication(const AppOptions& options_)
+		: m_options(options_)
+		, m_framesInFlight(options_.framesInFlight)
+	{
+	}
+
 	void run() {
-		initWindow();
+		CpuTrace::setEnabled(!m_options.traceFile.empty());
+		m_hostAllocator.setEnabled(m_options.hostAllocator);
+
+		if (enableValidationLayers) {
+			m_debugSink.setSeverityMask(m_options.debugSeverityMask);
+			m_debugSink.setTypeMask(m_options.debugTypeMask);
+			m_debugSink.setMaxLinesPerSecond(m_options.debugLinesPerSecond);
+			m_debugSink.start();
+		}
+
+		if (!m_options.headless) {
+			initWindow();
+		}
 		initVulkan();
 		mainLoop();
 		cleanup();
+
+		m_debugSink.stop();
+
+		if (CpuTrace::isEnabled()) {
+			CpuTrace::writeChromeJson(m_options.traceFile);
+		}
 	}
 
 private:
 	void initWindow() {
+		TRACE_SCOPE("initWindow");
+
 		//InitGLFW
 		glfwInit();
 
@@ -97,53 +402,190 @@ private:
 	}	
 
 	void initVulkan() {
+		TRACE_SCOPE("initVulkan");
+
 		createInstance();
 		setupDebugMessenger();
 		createSurface();
 		pickPhysicalDevice();
 		createLogicalDevice();
-		createSwapChain();
+		createPipelineCache();
+		createShaderCompiler();
+		createPipelineCompiler();
+		createGpuAllocator();
+		if (m_options.headless) {
+			createOffscreenTargets();
+		}
+		else {
+			createSwapChain();
+		}
 		createImageViews();
 		createRenderPass();
+		createDescriptorAllocator();
+		createBindlessTable();
 		createGraphicsPipeline();
+		createShaderWatcher();
 		createFramebuffers();
+		createRenderGraph();
 		createCommandPool();
+		createTransferCommandPool();
+		createVertexBuffer();
+		createIndexBuffer();
+		createInstanceBuffer();
+		submitUploads();
+		createUniformRing();
+		createGpuProfiler();
 		createCommandBuffers();
+		createFrameCommandPools();
+		createWorkerCommandPools(m_options.threadCount);
 		createSyncObjects();
 	}
 
 	void mainLoop() {
-		//Rendering loop, terminates if window is closed
-		while (!glfwWindowShouldClose(m_window)) {
+		if (m_options.benchmarkUpload) {
+			runUploadBenchmark();
+			return;
+		}
+
+		if (m_options.benchmarkAllocator) {
+			runAllocatorBenchmark();
+			return;
+		}
+
+		if (m_options.benchmarkThreads) {
+			runThreadScalingBenchmark();
+			return;
+		}
+
+		if (m_options.benchmarkUniforms) {
+			runUniformBenchmark();
+			return;
+		}
+
+		if (m_options.benchmarkInstancing) {
+			runInstancingBenchmark();
+			return;
+		}
+
+		//Rendering loop, terminates if window is closed or the requested number of frames was drawn
+		while (!shouldStop()) {
+			TRACE_SCOPE("frame");
 
 			//Poll input event
-			glfwPollEvents();
+			if (!m_options.headless) {
+				TRACE_SCOPE("glfwPollEvents");
+				glfwPollEvents();
+			}
 
+			auto start = std::chrono::high_resolution_clock::now();
 			drawFrame();
+			m_frameStats.addSample(std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count());
 		}
 
 		vkDeviceWaitIdle(m_vkLogicalDevice);
 	}
 
+	bool shouldStop()
+	{
+		if (m_options.frameCount > 0 && m_frameStats.count() >= m_options.frameCount) {
+			return true;
+		}
+		return !m_options.headless && glfwWindowShouldClose(m_window);
+	}
+
 	void cleanup() {
+		TRACE_SCOPE("cleanup");
+
+		m_frameStats.print(m_options.headless ? "headless drawFrame" : "drawFrame");
+		printResizeStats();
+		printRecordStats();
+		printHotReloadStats();
+		m_uniformRing.printStats();
+		m_descriptorAllocator.printStats();
+		m_bindlessTable.printStats();
+		if (m_renderGraph) {
+			m_renderGraph->printStats();
+		}
+
+		//A build still running uses the pipeline layout and render pass destroyed below
+		if (m_pendingPipeline.valid()) {
+			finishPendingPipeline();
+		}
+		m_pipelineCompiler.printStats();
+		m_pipelineCompiler.destroy();
+		m_shaderWatcher.destroy();
+
+		//Benchmarks run instead of the render loop, so no frame may have consumed the uploads
+		if (m_pendingUploads.submitted) {
+			vkQueueWaitIdle(m_transferQueue);
+			retireUploads();
+		}
+		flushDeferredDestructions(UINT64_MAX);
 		cleanupSwapChain();
-		for(size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+		cleanupRenderPipeline();
+		for(size_t i = 0; i < m_framesInFlight; i++)
 		{
-			vkDestroySemaphore(m_vkLogicalDevice, m_renderFinishedSemaphores[i], nullptr);
-			vkDestroySemaphore(m_vkLogicalDevice, m_imageAvailableSemaphores[i], nullptr);
-			vkDestroyFence(m_vkLogicalDevice, m_inFLightFences[i], nullptr);
+			vkDestroySemaphore(m_vkLogicalDevice, m_renderFinishedSemaphores[i], m_hostAllocator.callbacks());
+			vkDestroySemaphore(m_vkLogicalDevice, m_imageAvailableSemaphores[i], m_hostAllocator.callbacks());
 		}		
+		for (auto fence : m_inFLightFences) {
+			vkDestroyFence(m_vkLogicalDevice, fence, m_hostAllocator.callbacks());
+		}
+		if (m_frameTimeline != VK_NULL_HANDLE) {
+			vkDestroySemaphore(m_vkLogicalDevice, m_frameTimeline, m_hostAllocator.callbacks());
+		}
+
+		m_uniformRing.destroy();
+		m_descriptorAllocator.destroy();
+		m_bindlessTable.destroy();
+
+		if (m_instanceBuffer != VK_NULL_HANDLE) {
+			vkDestroyBuffer(m_vkLogicalDevice, m_instanceBuffer, m_hostAllocator.callbacks());
+			m_gpuAllocator.free(m_instanceBufferMemory);
+		}
+		vkDestroyBuffer(m_vkLogicalDevice, m_indexBuffer, m_hostAllocator.callbacks());
+		m_gpuAllocator.free(m_indexBufferMemory);
+		vkDestroyBuffer(m_vkLogicalDevice, m_vertexBuffer, m_hostAllocator.callbacks());
+		m_gpuAllocator.free(m_vertexBufferMemory);
+
+		vkDestroyCommandPool(m_vkLogicalDevice, m_commandPool, m_hostAllocator.callbacks());
+		vkDestroyCommandPool(m_vkLogicalDevice, m_transferCommandPool, m_hostAllocator.callbacks());
+		for (auto commandPool : m_frameCommandPools) {
+			vkDestroyCommandPool(m_vkLogicalDevice, commandPool, m_hostAllocator.callbacks());
+		}
+		destroyWorkerCommandPools();
+
+		m_gpuProfiler.printStats();
+		m_gpuProfiler.destroy();
+
+		m_shaderCompiler.printStats();
+		m_shaderCompiler.destroy();
+		m_assetArchive.close();
 
-		vkDestroyCommandPool(m_vkLogicalDevice, m_commandPool, nullptr);
+		m_pipelineCache.printStats();
+		m_pipelineCache.destroy();
+		if (m_hostAllocator.callbacks()) {
+			std::cout << "pipeline creation: " << m_pipelineHostAllocations << " host allocations" << std::endl;
+		}
+
+		m_gpuAllocator.printStats();
+		m_gpuAllocator.destroy();
 
-		vkDestroyDevice(m_vkLogicalDevice, nullptr);
+		vkDestroyDevice(m_vkLogicalDevice, m_hostAllocator.callbacks());
 		if (enableValidationLayers) {
-			DestroyDebugUtilsMessengerEXT(m_vkInstance, m_vkDebugMessenger, nullptr);
+			DestroyDebugUtilsMessengerEXT(m_vkInstance, m_vkDebugMessenger, m_hostAllocator.callbacks());
 		}
 
 		//Cleanup GLFW window and deinitialization
-		vkDestroySurfaceKHR(m_vkInstance, m_vkSurface, nullptr);
-		vkDestroyInstance(m_vkInstance, nullptr);
+		if (m_options.headless) {
+			vkDestroyInstance(m_vkInstance, m_hostAllocator.callbacks());
+			m_hostAllocator.printStats();
+			return;
+		}
+
+		vkDestroySurfaceKHR(m_vkInstance, m_vkSurface, m_hostAllocator.callbacks());
+		vkDestroyInstance(m_vkInstance, m_hostAllocator.callbacks());
+		m_hostAllocator.printStats();
 		glfwDestroyWindow(m_window);
 		glfwTerminate();
 	}
@@ -151,6 +593,8 @@ private:
 	//////////////////////////////////////////////////////////////////////////////////////////////////////
 	//////////////////////////////  Functions For Vulkan initiliazation : initVulkan()
 	void createInstance() {
+		TRACE_SCOPE("createInstance");
+
 		//Pre check for validation layers support
 		if (enableValidationLayers && !checkValidationLayerSuport()) {
 			throw std::runtime_error("validation layers requested, but not available! [::createInstance]");
@@ -164,7 +608,8 @@ private:
 		appInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
 		appInfo.pEngineName = "No Engine";
 		appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
-		appInfo.apiVersion = VK_API_VERSION_1_0;
+		//Querying timeline semaphore and descriptor indexing support needs vkGetPhysicalDeviceFeatures2 from Vulkan 1.1
+		appInfo.apiVersion = (m_options.timelineSemaphores || m_options.bindless) ? VK_API_VERSION_1_1 : VK_API_VERSION_1_0;
 
 		//2.
 		//Struct for vulkan instance info
@@ -198,12 +643,14 @@ private:
 
 		//3.
 		//Create Vulkan instance based on application and instance info
-		if (vkCreateInstance(&createInfo, nullptr, &m_vkInstance) != VK_SUCCESS) {
+		if (vkCreateInstance(&createInfo, m_hostAllocator.callbacks(), &m_vkInstance) != VK_SUCCESS) {
 			throw std::runtime_error("failed to create Vulkan Instance! [::createInstance]");
 		}
 	}
 
 	void setupDebugMessenger() {
+		TRACE_SCOPE("setupDebugMessenger");
+
 		if (!enableValidationLayers) {
 			return;
 		}
@@ -212,19 +659,27 @@ private:
 
 		populateDebugMessengerCreateInfo(createInfo);
 
-		if (CreateDebugUtilsMessengerEXT(m_vkInstance, &createInfo, nullptr, &m_vkDebugMessenger) != VK_SUCCESS) {
+		if (CreateDebugUtilsMessengerEXT(m_vkInstance, &createInfo, m_hostAllocator.callbacks(), &m_vkDebugMessenger) != VK_SUCCESS) {
 			throw std::runtime_error("failed to set up debug messenger [::setupDebugMessenger]");
 		}
 
 	}
 
 	void createSurface() {
-		if (glfwCreateWindowSurface(m_vkInstance, m_window, nullptr, &m_vkSurface) != VK_SUCCESS) {
+		TRACE_SCOPE("createSurface");
+
+		if (m_options.headless) {
+			return;
+		}
+
+		if (glfwCreateWindowSurface(m_vkInstance, m_window, m_hostAllocator.callbacks(), &m_vkSurface) != VK_SUCCESS) {
 			throw std::runtime_error("failed to create window surface! [::createSurface]");
 		}
 	}
 
 	void pickPhysicalDevice() {
+		TRACE_SCOPE("pickPhysicalDevice");
+
 		uint32_t deviceCount = 0;
 		//1. 
 		//Enumerate all devices and select one based on properties and features
@@ -237,25 +692,64 @@ private:
 		std::vector<VkPhysicalDevice> vkPhysicalDevices(deviceCount);
 		vkEnumeratePhysicalDevices(m_vkInstance, &deviceCount, vkPhysicalDevices.data());
 
-		for (const auto& device : vkPhysicalDevices)
-		{
-			if (isDeviceSuitable(device)) { // Can implement device selection criteria here
-				m_vkPhysicalDevice = device;
-				break;
+		//2.
+		//Query every device once, selection and all later setup read from these
+		auto start = std::chrono::high_resolution_clock::now();
+		std::vector<DeviceCapabilities> candidates;
+		for (const auto& device : vkPhysicalDevices) {
+			candidates.push_back(probeDevice(device));
+		}
+		double probeMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+		//3.
+		//Highest score wins unless the environment names a device
+		std::string deviceOverride = readEnvironmentVariable(DEVICE_OVERRIDE_VARIABLE);
+		size_t selected = candidates.size();
+		for (size_t i = 0; i < candidates.size(); i++) {
+			const DeviceCapabilities& candidate = candidates[i];
+			std::cout << "device " << i << ": " << candidate.properties.deviceName << ", " << deviceTypeName(candidate.properties.deviceType)
+				<< ", " << candidate.deviceLocalBytes / (1024 * 1024) << " MiB device local";
+			if (candidate.suitable) {
+				std::cout << ", score " << candidate.score << std::endl;
+			}
+			else {
+				std::cout << ", not suitable" << std::endl;
+			}
+
+			if (!deviceOverride.empty()) {
+				if (matchesDeviceOverride(candidate, i, deviceOverride) && selected == candidates.size()) {
+					selected = i;
+				}
+			}
+			else if (candidate.suitable && (selected == candidates.size() || candidate.score > candidates[selected].score)) {
+				selected = i;
 			}
 		}
 
-		if (m_vkPhysicalDevice == VK_NULL_HANDLE) {
+		if (selected == candidates.size()) {
+			if (!deviceOverride.empty()) {
+				throw std::runtime_error(std::string("no device matches ") + DEVICE_OVERRIDE_VARIABLE + "='" + deviceOverride + "' [::pickPhysicalDevice]");
+			}
 			throw std::runtime_error("failed to find a suitable GPU! [::pickPhysicalDevice]");
 		}
+		if (!candidates[selected].suitable) {
+			throw std::runtime_error(std::string("device '") + candidates[selected].properties.deviceName + "' selected by " + DEVICE_OVERRIDE_VARIABLE + " is not suitable [::pickPhysicalDevice]");
+		}
 
+		m_deviceCapabilities = std::move(candidates[selected]);
+		m_vkPhysicalDevice = m_deviceCapabilities.device;
+		std::cout << "selected device " << selected << " (" << m_deviceCapabilities.properties.deviceName << ")"
+			<< (deviceOverride.empty() ? "" : std::string(" from ") + DEVICE_OVERRIDE_VARIABLE)
+			<< ", probed " << candidates.size() << " devices in " << probeMs << " ms" << std::endl;
 	}
 
 	void createLogicalDevice() {
+		TRACE_SCOPE("createLogicalDevice");
+
 		//1.
 		//Get the required QueueFamily index from the physical device
-		QueueFamilyIndices indices = findQueueFamilies(m_vkPhysicalDevice);
-		std::set<uint32_t> uniqueQueueFamilies = { indices.graphicsFamily.value(), indices.presentFamily.value() };
+		const QueueFamilyIndices& indices = m_deviceCapabilities.queueFamilyIndices;
+		std::set<uint32_t> uniqueQueueFamilies = { indices.graphicsFamily.value(), indices.presentFamily.value(), indices.transferFamily.value(), indices.computeFamily.value() };
 
 		//2. 
 		//Create struct for Queue creation for the logical device
@@ -276,6 +770,16 @@ private:
 		//Create struct for logical device features
 		VkPhysicalDeviceFeatures deviceFeatures = {};
 
+		//Bindless arrays are indexed with push constants, dynamically uniform indexing is enough
+		m_bindlessEnabled = m_options.bindless && m_deviceCapabilities.descriptorIndexing;
+		if (m_options.bindless && !m_bindlessEnabled) {
+			std::cout << m_deviceCapabilities.properties.deviceName << ": no usable descriptor indexing, --bindless falls back to per draw binds" << std::endl;
+		}
+		if (m_bindlessEnabled) {
+			deviceFeatures.shaderStorageBufferArrayDynamicIndexing = VK_TRUE;
+			deviceFeatures.shaderSampledImageArrayDynamicIndexing = VK_TRUE;
+		}
+
 		//4. 
 		//Create struct for device creation info
 		VkDeviceCreateInfo createInfo = {};
@@ -284,8 +788,51 @@ private:
 		createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
 		createInfo.pEnabledFeatures = &deviceFeatures;
 
-		createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
-		createInfo.ppEnabledExtensionNames = deviceExtensions.data();
+		//Optional extensions are enabled on top of the required ones when the device has them
+		std::vector<const char*> enabledExtensions;
+		if (!m_options.headless) {
+			enabledExtensions.assign(deviceExtensions.begin(), deviceExtensions.end());
+		}
+		m_pipelineCreationFeedbackSupported = m_deviceCapabilities.extensions.count(VK_EXT_PIPELINE_CREATION_FEEDBACK_EXTENSION_NAME) > 0;
+		if (m_pipelineCreationFeedbackSupported) {
+			enabledExtensions.push_back(VK_EXT_PIPELINE_CREATION_FEEDBACK_EXTENSION_NAME);
+		}
+
+		//The vendored headers predate Vulkan 1.2, so timeline semaphores come from VK_KHR_timeline_semaphore
+		VkPhysicalDeviceTimelineSemaphoreFeaturesKHR timelineFeatures = {};
+		timelineFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES_KHR;
+		if (m_options.timelineSemaphores) {
+			m_timelineSemaphoresEnabled = m_deviceCapabilities.timelineSemaphore;
+			if (m_timelineSemaphoresEnabled) {
+				enabledExtensions.push_back(VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME);
+				timelineFeatures.timelineSemaphore = VK_TRUE;
+				createInfo.pNext = &timelineFeatures;
+			}
+			else {
+				std::cout << "timeline semaphores not supported, falling back to fences" << std::endl;
+			}
+		}
+
+		//VK_EXT_descriptor_indexing is enabled as a device extension, it is not core before Vulkan 1.2. It depends on
+		//VK_KHR_maintenance3, which is core in the Vulkan 1.1 instance we asked for and listed as well for older drivers.
+		VkPhysicalDeviceDescriptorIndexingFeaturesEXT indexingFeatures = {};
+		indexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+		if (m_bindlessEnabled) {
+			enabledExtensions.push_back(VK_KHR_MAINTENANCE3_EXTENSION_NAME);
+			enabledExtensions.push_back(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
+			indexingFeatures.runtimeDescriptorArray = VK_TRUE;
+			indexingFeatures.descriptorBindingPartiallyBound = VK_TRUE;
+			indexingFeatures.descriptorBindingStorageBufferUpdateAfterBind = VK_TRUE;
+			indexingFeatures.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+			indexingFeatures.pNext = const_cast<void*>(createInfo.pNext);
+			createInfo.pNext = &indexingFeatures;
+		}
+		else if (m_options.bindless) {
+			std::cout << "descriptor indexing not supported, falling back to per draw descriptor binds" << std::endl;
+		}
+
+		createInfo.enabledExtensionCount = static_cast<uint32_t>(enabledExtensions.size());
+		createInfo.ppEnabledExtensionNames = enabledExtensions.data();
 		if (enableValidationLayers) {
 			createInfo.enabledLayerCount = static_cast<uint32_t>(validationLayers.size());
 			createInfo.ppEnabledLayerNames = validationLayers.data();
@@ -297,16 +844,64 @@ private:
 
 		//5. 
 		//Create device and get the queue required from it
-		if (vkCreateDevice(m_vkPhysicalDevice, &createInfo, nullptr, &m_vkLogicalDevice) != VK_SUCCESS) {
+		if (vkCreateDevice(m_vkPhysicalDevice, &createInfo, m_hostAllocator.callbacks(), &m_vkLogicalDevice) != VK_SUCCESS) {
 			throw std::runtime_error("failed to create logical device [::createLogicalDevice]");
 		}
 
 		vkGetDeviceQueue(m_vkLogicalDevice, indices.graphicsFamily.value(), 0, &m_graphicsQueue);
 		vkGetDeviceQueue(m_vkLogicalDevice, indices.presentFamily.value(), 0, &m_presentQueue);
+		vkGetDeviceQueue(m_vkLogicalDevice, indices.transferFamily.value(), 0, &m_transferQueue);
+		vkGetDeviceQueue(m_vkLogicalDevice, indices.computeFamily.value(), 0, &m_computeQueue);
+
+		uint32_t graphicsFamily = indices.graphicsFamily.value();
+		std::cout << "queue families: graphics " << graphicsFamily << ", present " << indices.presentFamily.value()
+			<< ", transfer " << indices.transferFamily.value() << (indices.transferFamily.value() != graphicsFamily ? " (dedicated)" : "")
+			<< ", compute " << indices.computeFamily.value() << (indices.computeFamily.value() != graphicsFamily ? " (async)" : "") << std::endl;
+
+		if (m_timelineSemaphoresEnabled) {
+			m_pfnWaitSemaphores = (PFN_vkWaitSemaphoresKHR)vkGetDeviceProcAddr(m_vkLogicalDevice, "vkWaitSemaphoresKHR");
+			m_pfnGetSemaphoreCounterValue = (PFN_vkGetSemaphoreCounterValueKHR)vkGetDeviceProcAddr(m_vkLogicalDevice, "vkGetSemaphoreCounterValueKHR");
+		}
+	}
+
+	void createPipelineCache()
+	{
+		TRACE_SCOPE("createPipelineCache");
+
+		//Shared by every pipeline creation, so recreating the pipeline on resize is served from the cache
+		m_pipelineCache.create(m_vkLogicalDevice, m_vkPhysicalDevice, PIPELINE_CACHE_FILE, m_pipelineCreationFeedbackSupported, m_hostAllocator.callbacks());
+	}
+
+	void createShaderCompiler()
+	{
+		TRACE_SCOPE("createShaderCompiler");
+
+		m_shaderCompiler.create(SHADER_CACHE_DIRECTORY);
+
+		//One open and one mapping for every shader, instead of a source, a cache entry and its includes per shader
+		if (!m_options.archiveFile.empty()) {
+			auto start = std::chrono::high_resolution_clock::now();
+			m_assetArchive.open(m_options.archiveFile);
+			m_shaderCompiler.setArchive(&m_assetArchive);
+
+			double elapsedMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+			std::cout << "asset archive '" << m_options.archiveFile << "': " << m_assetArchive.entryCount() << " entries, "
+				<< m_assetArchive.mappedBytes() << " bytes mapped in " << elapsedMs << " ms" << std::endl;
+		}
+	}
+
+	void createPipelineCompiler()
+	{
+		TRACE_SCOPE("createPipelineCompiler");
+
+		//Pipeline builds are rare, leave most cores to command recording
+		m_pipelineCompiler.create(std::min(4u, std::thread::hardware_concurrency() / 2));
 	}
 
-	void createSwapChain()
+	void createSwapChain(VkSwapchainKHR oldSwapChain_ = VK_NULL_HANDLE)
 	{
+		TRACE_SCOPE("createSwapChain");
+
 		//1. Retrieve Swap Chain properties(detail below) supported for the device
 			/*
 			 Basic surface capabilities(min / max number of images in swap chain, min / -
@@ -314,7 +909,7 @@ private:
 			 Surface formats(pixel format, color space)
 			 Available presentation modes
 			*/
-		SwapChainSupportDetails swapChainSupport = querySwapChainSupport(m_vkPhysicalDevice);
+		SwapChainSupportDetails swapChainSupport = querySwapChainSupport();
 
 		//2. Choose the right settings for:
 			/*
@@ -343,7 +938,15 @@ private:
 		createInfo.imageArrayLayers = 1;
 		createInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
 
-		QueueFamilyIndices indices = findQueueFamilies(m_vkPhysicalDevice);
+		//The render graph blits its result into the swap chain image
+		if (m_options.renderGraph) {
+			if (!(swapChainSupport.capabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_DST_BIT)) {
+				throw std::runtime_error("swap chain images can not be blitted to, which --render-graph needs [::createSwapChain]");
+			}
+			createInfo.imageUsage |= VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+		}
+
+		const QueueFamilyIndices& indices = m_deviceCapabilities.queueFamilyIndices;
 		uint32_t queueFamilyIndices[] = { indices.graphicsFamily.value(), indices.presentFamily.value() };
 
 		if (indices.graphicsFamily != indices.presentFamily) {
@@ -361,9 +964,9 @@ private:
 		createInfo.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
 		createInfo.presentMode = presentMode;
 		createInfo.clipped = VK_TRUE;
-		createInfo.oldSwapchain = VK_NULL_HANDLE;
+		createInfo.oldSwapchain = oldSwapChain_;
 
-		if (vkCreateSwapchainKHR(m_vkLogicalDevice, &createInfo, nullptr, &m_swapChain) != VK_SUCCESS) {
+		if (vkCreateSwapchainKHR(m_vkLogicalDevice, &createInfo, m_hostAllocator.callbacks(), &m_swapChain) != VK_SUCCESS) {
 			throw std::runtime_error("failed to create swap chain!");
 		}
 
@@ -375,7 +978,71 @@ private:
 		m_swapChainExtent = extent;
 	}
 
+	//The format a swap chain would most likely have, or its RGBA twin
+	VkFormat chooseOffscreenFormat()
+	{
+		VkFormatFeatureFlags requiredFeatures = VK_FORMAT_FEATURE_COLOR_ATTACHMENT_BIT;
+		if (m_options.renderGraph) {
+			requiredFeatures |= VK_FORMAT_FEATURE_BLIT_DST_BIT;
+		}
+
+		//Before Vulkan 1.1 (VK_KHR_maintenance1) every format supports transfers without reporting it
+		if (m_deviceCapabilities.properties.apiVersion >= VK_API_VERSION_1_1) {
+			requiredFeatures |= VK_FORMAT_FEATURE_TRANSFER_SRC_BIT;
+		}
+
+		const VkFormat candidates[] = { VK_FORMAT_B8G8R8A8_UNORM, VK_FORMAT_R8G8B8A8_UNORM };
+		for (VkFormat format : candidates) {
+			VkFormatProperties properties;
+			vkGetPhysicalDeviceFormatProperties(m_vkPhysicalDevice, format, &properties);
+			if ((properties.optimalTilingFeatures & requiredFeatures) == requiredFeatures) {
+				return format;
+			}
+		}
+
+		throw std::runtime_error("no offscreen color format supports rendering and readback! [::chooseOffscreenFormat]");
+	}
+
+	//Headless replacement for the swap chain: a ring of images the size of the window, one per frame in flight.
+	//They are stored in m_swapChainImages so image views, framebuffers and recording are shared with the windowed path.
+	void createOffscreenTargets()
+	{
+		TRACE_SCOPE("createOffscreenTargets");
+
+		m_swapChainImageFormat = chooseOffscreenFormat();
+		m_swapChainExtent = { static_cast<uint32_t>(WIDTH), static_cast<uint32_t>(HEIGHT) };
+
+		m_swapChainImages.resize(m_framesInFlight);
+		m_offscreenImageMemory.resize(m_framesInFlight);
+
+		for (size_t i = 0; i < m_swapChainImages.size(); i++) {
+			VkImageCreateInfo imageInfo = {};
+			imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+			imageInfo.imageType = VK_IMAGE_TYPE_2D;
+			imageInfo.format = m_swapChainImageFormat;
+			imageInfo.extent = { m_swapChainExtent.width, m_swapChainExtent.height, 1 };
+			imageInfo.mipLevels = 1;
+			imageInfo.arrayLayers = 1;
+			imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+			imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+			imageInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+			if (m_options.renderGraph) {
+				imageInfo.usage |= VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+			}
+			imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+			imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+			if (vkCreateImage(m_vkLogicalDevice, &imageInfo, m_hostAllocator.callbacks(), &m_swapChainImages[i]) != VK_SUCCESS) {
+				throw std::runtime_error("failed to create offscreen image! [::createOffscreenTargets]");
+			}
+
+			m_gpuAllocator.allocateImageMemory(m_swapChainImages[i], imageInfo.tiling, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_offscreenImageMemory[i]);
+		}
+	}
+
 	void createImageViews() {
+		TRACE_SCOPE("createImageViews");
+
 		//Create Image views corresponding to swap chain images
 		m_swapChainImageViews.resize(m_swapChainImages.size());
 		for (size_t i = 0; i < m_swapChainImages.size(); i++) {
@@ -393,7 +1060,7 @@ private:
 			createInfo.subresourceRange.levelCount = 1;
 			createInfo.subresourceRange.baseArrayLayer = 0;
 			createInfo.subresourceRange.layerCount = 1;
-			if (vkCreateImageView(m_vkLogicalDevice, &createInfo, nullptr, &m_swapChainImageViews[i])) {
+			if (vkCreateImageView(m_vkLogicalDevice, &createInfo, m_hostAllocator.callbacks(), &m_swapChainImageViews[i])) {
 				throw::std::runtime_error("failed to create image views!");
 			}
 		}
@@ -401,6 +1068,8 @@ private:
 	}
 
 	void createRenderPass() {
+		TRACE_SCOPE("createRenderPass");
+
 		VkAttachmentDescription colorAttachment = {};
 		colorAttachment.format = m_swapChainImageFormat;
 		colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
@@ -409,7 +1078,8 @@ private:
 		colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
 		colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
 		colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-		colorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+		//Offscreen targets are left ready for a readback copy, there is no presentation engine to hand them to
+		colorAttachment.finalLayout = m_options.headless ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
 
 		VkAttachmentReference colorAttachmentReference = {};
 		colorAttachmentReference.attachment = 0;
@@ -438,7 +1108,7 @@ private:
 		renderPassInfo.pDependencies = &dependency;
 
 
-		if (vkCreateRenderPass(m_vkLogicalDevice, &renderPassInfo, nullptr, &m_renderPass) != VK_SUCCESS) {
+		if (vkCreateRenderPass(m_vkLogicalDevice, &renderPassInfo, m_hostAllocator.callbacks(), &m_renderPass) != VK_SUCCESS) {
 			throw std::runtime_error("failed to create render pass!");
 		}
 
@@ -446,9 +1116,76 @@ private:
 	}
 
 	void createGraphicsPipeline() {
-		//1. Create Shader program
-		auto vertShaderCode = readFile("..\\shaders\\triangle_vert.spv");
-		auto fragShaderCode = readFile("..\\shaders\\triangle_frag.spv");
+		TRACE_SCOPE("createGraphicsPipeline");
+
+		//Cached, a rebuild after a format change gets the layout the uniform set was allocated with
+		m_descriptorSetLayout = m_bindlessEnabled ? m_bindlessTable.layout() : m_descriptorAllocator.getLayout(drawUniformBindings());
+
+		//Bindless draws only tell the shader where their data is
+		VkPushConstantRange pushConstantRange = {};
+		pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+		pushConstantRange.offset = 0;
+		pushConstantRange.size = sizeof(BindlessDrawConstants);
+
+		VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
+		pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+		pipelineLayoutInfo.setLayoutCount = 1;
+		pipelineLayoutInfo.pSetLayouts = &m_descriptorSetLayout;
+		pipelineLayoutInfo.pushConstantRangeCount = m_bindlessEnabled ? 1 : 0;
+		pipelineLayoutInfo.pPushConstantRanges = m_bindlessEnabled ? &pushConstantRange : nullptr;
+
+		if (vkCreatePipelineLayout(m_vkLogicalDevice, &pipelineLayoutInfo, m_hostAllocator.callbacks(), &m_pipelineLayout) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create pipeline layout!");
+		}
+
+		//Frames skip their draws until updatePendingPipeline() swaps the finished pipeline in
+		if (m_options.asyncPipelines) {
+			m_graphicsPipeline = VK_NULL_HANDLE;
+			submitGraphicsPipeline();
+			return;
+		}
+
+		uint64_t hostAllocationsBefore = m_hostAllocator.counters().totalAllocations();
+		m_graphicsPipeline = buildGraphicsPipeline(m_renderPass);
+		m_pipelineHostAllocations += m_hostAllocator.counters().totalAllocations() - hostAllocationsBefore;
+	}
+
+	//Shader sources of the graphics pipeline, also the files watched for hot reload
+	std::vector<ShaderCompiler::ShaderDesc> graphicsPipelineShaders() const
+	{
+		ShaderCompiler::ShaderDesc vertShaderDesc;
+		vertShaderDesc.stage = ShaderCompiler::Stage::Vertex;
+		if (m_options.instanced) {
+			vertShaderDesc.sourcePath = "../shaders/VertexBufferInstanced.vert";
+			vertShaderDesc.fallbackSpirvPath = "../shaders/VertexBufferInstanced_vert.spv";
+		}
+		else if (m_bindlessEnabled) {
+			vertShaderDesc.sourcePath = "../shaders/VertexBufferBindless.vert";
+			vertShaderDesc.fallbackSpirvPath = "../shaders/VertexBufferBindless_vert.spv";
+		}
+		else {
+			vertShaderDesc.sourcePath = "../shaders/VertexBuffer.vert";
+			vertShaderDesc.fallbackSpirvPath = "../shaders/VertexBuffer_vert.spv";
+		}
+
+		ShaderCompiler::ShaderDesc fragShaderDesc;
+		fragShaderDesc.sourcePath = "../shaders/TriangleShader.frag";
+		fragShaderDesc.stage = ShaderCompiler::Stage::Fragment;
+		fragShaderDesc.fallbackSpirvPath = "../shaders/Triangle_frag.spv";
+
+		return { vertShaderDesc, fragShaderDesc };
+	}
+
+	//Compiles the shaders and creates the pipeline against m_pipelineLayout and renderPass_.
+	//Only touches thread safe state, so hot reload runs it on a worker thread.
+	VkPipeline buildGraphicsPipeline(VkRenderPass renderPass_)
+	{
+		TRACE_SCOPE("buildGraphicsPipeline");
+
+		//1. Create Shader program, compiled from GLSL unless the shader cache already has it
+		std::vector<ShaderCompiler::ShaderDesc> shaderDescs = graphicsPipelineShaders();
+		auto vertShaderCode = m_shaderCompiler.load(shaderDescs[0]);
+		auto fragShaderCode = m_shaderCompiler.load(shaderDescs[1]);
 
 		VkShaderModule vertShaderModule = createShaderModule(vertShaderCode);
 		VkShaderModule fragShaderModule = createShaderModule(fragShaderCode);
@@ -469,12 +1206,22 @@ private:
 		VkPipelineShaderStageCreateInfo shaderStages[] = { vertShaderStageInfo, fragShaderStageInfo };
 
 		//2. Vertex Input Assembly
+		//The instanced pipeline adds the per instance stream as binding 1
+		std::vector<VkVertexInputBindingDescription> bindingDescriptions = { Vertex::getBindingDescription() };
+		auto vertexAttributes = Vertex::getAttributeDescriptions();
+		std::vector<VkVertexInputAttributeDescription> attributeDescriptions(vertexAttributes.begin(), vertexAttributes.end());
+		if (m_options.instanced) {
+			auto instanceAttributes = InstanceData::getAttributeDescriptions();
+			bindingDescriptions.push_back(InstanceData::getBindingDescription());
+			attributeDescriptions.insert(attributeDescriptions.end(), instanceAttributes.begin(), instanceAttributes.end());
+		}
+
 		VkPipelineVertexInputStateCreateInfo vertexInputInfo = {};
 		vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-		vertexInputInfo.vertexBindingDescriptionCount = 0;
-		vertexInputInfo.pVertexAttributeDescriptions = nullptr;
-		vertexInputInfo.vertexAttributeDescriptionCount = 0;
-		vertexInputInfo.pVertexAttributeDescriptions = nullptr;
+		vertexInputInfo.vertexBindingDescriptionCount = static_cast<uint32_t>(bindingDescriptions.size());
+		vertexInputInfo.pVertexBindingDescriptions = bindingDescriptions.data();
+		vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());
+		vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
 
 		VkPipelineInputAssemblyStateCreateInfo inputAssembly = {};
 		inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
@@ -482,24 +1229,20 @@ private:
 		inputAssembly.primitiveRestartEnable = VK_FALSE;
 
 		//3. Viewport and Scissor
-		VkViewport viewport = {};
-		viewport.x = 0.0f;
-		viewport.y = 0.0f;
-		viewport.width = (float)m_swapChainExtent.width;
-		viewport.height = (float)m_swapChainExtent.height;
-		viewport.minDepth = 0.0f;
-		viewport.maxDepth = 1.0f;
-
-		VkRect2D scissor = {};
-		scissor.offset = { 0,0 };
-		scissor.extent = m_swapChainExtent;
-
+		//Both are dynamic and set while recording, so the pipeline does not depend on the swap chain extent
 		VkPipelineViewportStateCreateInfo viewportState = {};
 		viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
 		viewportState.viewportCount = 1;
-		viewportState.pViewports = &viewport;
+		viewportState.pViewports = nullptr;
 		viewportState.scissorCount = 1;
-		viewportState.pScissors = &scissor;
+		viewportState.pScissors = nullptr;
+
+		VkDynamicState dynamicStates[] = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+
+		VkPipelineDynamicStateCreateInfo dynamicState = {};
+		dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+		dynamicState.dynamicStateCount = 2;
+		dynamicState.pDynamicStates = dynamicStates;
 
 		//4. Rasterizer
 		VkPipelineRasterizationStateCreateInfo rasterizer = {};
@@ -551,18 +1294,6 @@ private:
 		colorBlending.blendConstants[3] = 0.f;
 
 		//8. The Graphics Pipeline
-
-		VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
-		pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-		pipelineLayoutInfo.setLayoutCount = 0;
-		pipelineLayoutInfo.pSetLayouts = nullptr;
-		pipelineLayoutInfo.pushConstantRangeCount = 0;
-		pipelineLayoutInfo.pPushConstantRanges = nullptr;
-
-		if (vkCreatePipelineLayout(m_vkLogicalDevice, &pipelineLayoutInfo, nullptr, &m_pipelineLayout) != VK_SUCCESS) {
-			throw std::runtime_error("failed to create pipeline layout!");
-		}
-
 		VkGraphicsPipelineCreateInfo pipelineInfo = {};
 		pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
 		pipelineInfo.stageCount = 2;
@@ -574,24 +1305,161 @@ private:
 		pipelineInfo.pMultisampleState = &multisampling;
 		pipelineInfo.pDepthStencilState = nullptr;
 		pipelineInfo.pColorBlendState = &colorBlending;
-		pipelineInfo.pDynamicState = nullptr;
+		pipelineInfo.pDynamicState = &dynamicState;
 		pipelineInfo.layout = m_pipelineLayout;
-		pipelineInfo.renderPass = m_renderPass;
+		pipelineInfo.renderPass = renderPass_;
 		pipelineInfo.subpass = 0;
 		pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
 		pipelineInfo.basePipelineIndex = -1;
 
-		if (vkCreateGraphicsPipelines(m_vkLogicalDevice, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &m_graphicsPipeline) != VK_SUCCESS) {
+		VkPipeline pipeline = VK_NULL_HANDLE;
+		VkResult result = m_pipelineCache.createGraphicsPipelines(1, &pipelineInfo, &pipeline);
+
+		vkDestroyShaderModule(m_vkLogicalDevice, fragShaderModule, m_hostAllocator.callbacks());
+		vkDestroyShaderModule(m_vkLogicalDevice, vertShaderModule, m_hostAllocator.callbacks());
+
+		if (result != VK_SUCCESS) {
 			throw std::runtime_error("failed to create graphics pipeline!!!");
 		}
+		return pipeline;
+	}
+
+	void createShaderWatcher()
+	{
+		TRACE_SCOPE("createShaderWatcher");
+
+		if (!m_options.hotReload) {
+			return;
+		}
+
+		m_shaderWatcher.create();
+		watchPipelineShaders();
+	}
+
+	//Called again after every rebuild, so includes added while running are watched as well
+	void watchPipelineShaders()
+	{
+		for (const auto& shaderDesc : graphicsPipelineShaders()) {
+			for (const auto& file : m_shaderCompiler.dependencies(shaderDesc.sourcePath)) {
+				m_shaderWatcher.watch(file);
+			}
+
+			//Rerunning compileTriangle.bat triggers a reload too, for builds without shaderc
+			m_shaderWatcher.watch(shaderDesc.fallbackSpirvPath);
+		}
+	}
+
+	//Queues buildGraphicsPipeline() on the pipeline compiler, at most one build is pending at a time
+	void submitGraphicsPipeline()
+	{
+		VkRenderPass renderPass = m_renderPass;
+		m_pendingPipelineStart = std::chrono::high_resolution_clock::now();
+		m_pendingPipeline = m_pipelineCompiler.submit("graphics", [this, renderPass]() {
+			return buildGraphicsPipeline(renderPass);
+		});
+	}
+
+	//Runs at the frame boundary, before anything is recorded with the current pipeline
+	void updatePendingPipeline()
+	{
+		if (m_pendingPipeline.valid() && m_pendingPipeline.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+			finishPendingPipeline();
+		}
+	}
+
+	//Takes the built pipeline, blocking if it is not done yet. Frames recorded from now on use it and a replaced
+	//pipeline is destroyed once the frames already submitted with it have finished, so the GPU is never drained.
+	void finishPendingPipeline()
+	{
+		bool reload = m_graphicsPipeline != VK_NULL_HANDLE;
+
+		VkPipeline pipeline = VK_NULL_HANDLE;
+		try {
+			pipeline = m_pendingPipeline.get();
+		}
+		catch (const std::exception& e) {
+			//Without a previous pipeline there is nothing to keep drawing with
+			if (!reload) {
+				throw;
+			}
+
+			//Keep drawing with the previous pipeline until the next edit fixes the error
+			m_hotReload.failures++;
+			std::cerr << "shader hot reload failed, keeping the previous pipeline:\n" << e.what() << std::endl;
+			return;
+		}
+
+		if (reload) {
+			VkDevice device = m_vkLogicalDevice;
+			const VkAllocationCallbacks* allocator = m_hostAllocator.callbacks();
+			VkPipeline oldPipeline = m_graphicsPipeline;
+			deferDestruction([=]() {
+				vkDestroyPipeline(device, oldPipeline, allocator);
+			});
+		}
+		m_graphicsPipeline = pipeline;
+
+		double elapsedMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - m_pendingPipelineStart).count();
+		if (!reload) {
+			std::cout << "graphics pipeline ready after " << elapsedMs << " ms, "
+				<< m_framesWithoutPipeline << " frames recorded without draws" << std::endl;
+			return;
+		}
+
+		watchPipelineShaders();
+
+		m_hotReload.count++;
+		m_hotReload.totalMs += elapsedMs;
+		m_hotReload.maxMs = std::max(m_hotReload.maxMs, elapsedMs);
+		std::cout << "shader hot reload: pipeline rebuilt in " << elapsedMs << " ms" << std::endl;
+	}
+
+	//Starts a background rebuild once edited shader files have settled
+	void updateShaderHotReload()
+	{
+		if (!m_options.hotReload) {
+			return;
+		}
 
+		TRACE_SCOPE("updateShaderHotReload");
 
-		vkDestroyShaderModule(m_vkLogicalDevice, fragShaderModule, nullptr);
-		vkDestroyShaderModule(m_vkLogicalDevice, vertShaderModule, nullptr);
+		//Editors often write a file in several steps, compiling the first one would only produce errors
+		const auto SETTLE_TIME = std::chrono::milliseconds(50);
+		auto now = std::chrono::high_resolution_clock::now();
+
+		std::vector<std::string> changed;
+		m_shaderWatcher.poll(changed);
+		for (const auto& file : changed) {
+			std::cout << "shader hot reload: '" << file << "' changed" << std::endl;
+		}
+		if (!changed.empty()) {
+			m_hotReload.dirty = true;
+			m_hotReload.lastChange = now;
+		}
+
+		if (m_hotReload.dirty && !m_pendingPipeline.valid() && now - m_hotReload.lastChange >= SETTLE_TIME) {
+			m_hotReload.dirty = false;
+			submitGraphicsPipeline();
+		}
+	}
+
+	void printHotReloadStats()
+	{
+		if (m_hotReload.count == 0 && m_hotReload.failures == 0) {
+			return;
+		}
+
+		std::cout << "shader hot reload: " << m_hotReload.count << " reloads, " << m_hotReload.failures << " failed";
+		if (m_hotReload.count > 0) {
+			std::cout << ", avg " << m_hotReload.totalMs / m_hotReload.count << " ms, max " << m_hotReload.maxMs << " ms";
+		}
+		std::cout << std::endl;
 	}
 
 	void createFramebuffers()
 	{
+		TRACE_SCOPE("createFramebuffers");
+
 		m_swapChainFramebuffers.resize(m_swapChainImageViews.size());
 		for (size_t i = 0; i < m_swapChainImageViews.size(); i++)
 		{
@@ -606,7 +1474,7 @@ private:
 			framebufferInfo.height = m_swapChainExtent.height;
 			framebufferInfo.layers = 1;
 
-			if (vkCreateFramebuffer(m_vkLogicalDevice, &framebufferInfo, nullptr, &m_swapChainFramebuffers[i]) != VK_SUCCESS)
+			if (vkCreateFramebuffer(m_vkLogicalDevice, &framebufferInfo, m_hostAllocator.callbacks(), &m_swapChainFramebuffers[i]) != VK_SUCCESS)
 			{
 				throw std::runtime_error("failed to create Framebuffer");
 			}
@@ -614,23 +1482,139 @@ private:
 
 	}
 
+	//The frame as a render graph. Only the scene pass draws, the rest are blits, so no pipeline or shader beyond
+	//the existing ones is involved. The scene pass has the same single color attachment format as m_renderPass,
+	//which keeps it compatible with the graphics pipeline built against m_renderPass.
+	void createRenderGraph()
+	{
+		TRACE_SCOPE("createRenderGraph");
+
+		if (!m_options.renderGraph) {
+			return;
+		}
+
+		//1. Blits need format support, linear filtering is nice to have
+		VkFormatProperties formatProperties;
+		vkGetPhysicalDeviceFormatProperties(m_vkPhysicalDevice, m_swapChainImageFormat, &formatProperties);
+		VkFormatFeatureFlags blitFeatures = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT;
+		if ((formatProperties.optimalTilingFeatures & blitFeatures) != blitFeatures) {
+			throw std::runtime_error("swap chain format does not support blits [::createRenderGraph]");
+		}
+		VkFilter filter = (formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT) ? VK_FILTER_LINEAR : VK_FILTER_NEAREST;
+
+		m_renderGraph = std::make_unique<RenderGraph>();
+		RenderGraph& graph = *m_renderGraph;
+		graph.create(m_vkLogicalDevice, &m_gpuAllocator, m_hostAllocator.callbacks());
+
+		//2. Frames wait for the acquired image at color attachment output, its first barrier chains to that stage
+		VkExtent2D halfExtent = { std::max(1u, m_swapChainExtent.width / 2), std::max(1u, m_swapChainExtent.height / 2) };
+		m_backbuffer = graph.importImage("backbuffer", m_swapChainImageFormat, m_swapChainExtent, VK_IMAGE_LAYOUT_UNDEFINED,
+			VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, m_options.headless ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+		RenderGraph::Resource sceneColor = graph.createImage("sceneColor", m_swapChainImageFormat, m_swapChainExtent);
+		RenderGraph::Resource halfColor = graph.createImage("halfColor", m_swapChainImageFormat, halfExtent);
+		RenderGraph::Resource postColor = graph.createImage("postColor", m_swapChainImageFormat, m_swapChainExtent);
+
+		//3. Passes in execution order
+		m_scenePass = graph.addPass("scene", [this](const RenderGraph::PassContext& context_) {
+			if (m_threadPool) {
+				recordSecondaryCommandBuffers(context_.commandBuffer, context_.renderPass, context_.framebuffer);
+			}
+			else {
+				recordDraws(context_.commandBuffer, 0, m_options.drawCount);
+			}
+		});
+		graph.write(m_scenePass, sceneColor, RenderGraph::Usage::ColorAttachment);
+
+		RenderGraph::Pass downsample = graph.addPass("downsample", [this, sceneColor, halfColor, filter](const RenderGraph::PassContext& context_) {
+			blitImage(context_.commandBuffer, context_.graph->image(sceneColor), context_.graph->extent(sceneColor),
+				context_.graph->image(halfColor), context_.graph->extent(halfColor), filter);
+		});
+		graph.read(downsample, sceneColor, RenderGraph::Usage::TransferSrc);
+		graph.write(downsample, halfColor, RenderGraph::Usage::TransferDst);
+
+		RenderGraph::Pass upsample = graph.addPass("upsample", [this, halfColor, postColor, filter](const RenderGraph::PassContext& context_) {
+			blitImage(context_.commandBuffer, context_.graph->image(halfColor), context_.graph->extent(halfColor),
+				context_.graph->image(postColor), context_.graph->extent(postColor), filter);
+		});
+		graph.read(upsample, halfColor, RenderGraph::Usage::TransferSrc);
+		graph.write(upsample, postColor, RenderGraph::Usage::TransferDst);
+
+		RenderGraph::Resource backbuffer = m_backbuffer;
+		RenderGraph::Pass present = graph.addPass("present", [this, postColor, backbuffer](const RenderGraph::PassContext& context_) {
+			blitImage(context_.commandBuffer, context_.graph->image(postColor), context_.graph->extent(postColor),
+				context_.graph->image(backbuffer), context_.graph->extent(backbuffer), VK_FILTER_NEAREST);
+		});
+		graph.read(present, postColor, RenderGraph::Usage::TransferSrc);
+		graph.write(present, m_backbuffer, RenderGraph::Usage::TransferDst);
+
+		//4. sceneColor and postColor never live at the same time and end up sharing memory
+		graph.compile();
+	}
+
+	//Whole image blit between two images in their transfer layouts
+	void blitImage(VkCommandBuffer commandBuffer_, VkImage src_, VkExtent2D srcExtent_, VkImage dst_, VkExtent2D dstExtent_, VkFilter filter_)
+	{
+		VkImageBlit region = {};
+		region.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		region.srcSubresource.layerCount = 1;
+		region.srcOffsets[1] = { static_cast<int32_t>(srcExtent_.width), static_cast<int32_t>(srcExtent_.height), 1 };
+		region.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		region.dstSubresource.layerCount = 1;
+		region.dstOffsets[1] = { static_cast<int32_t>(dstExtent_.width), static_cast<int32_t>(dstExtent_.height), 1 };
+
+		vkCmdBlitImage(commandBuffer_, src_, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, dst_, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region, filter_);
+	}
+
 	void createCommandPool()
 	{
-		QueueFamilyIndices queueFamilyIndices = findQueueFamilies(m_vkPhysicalDevice);
+		TRACE_SCOPE("createCommandPool");
+
+		const QueueFamilyIndices& queueFamilyIndices = m_deviceCapabilities.queueFamilyIndices;
 
 		VkCommandPoolCreateInfo poolInfo = {};
 		poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
 		poolInfo.queueFamilyIndex = queueFamilyIndices.graphicsFamily.value();
 		poolInfo.flags = 0;
 
-		if (vkCreateCommandPool(m_vkLogicalDevice, &poolInfo, nullptr, &m_commandPool) != VK_SUCCESS)
+		if (vkCreateCommandPool(m_vkLogicalDevice, &poolInfo, m_hostAllocator.callbacks(), &m_commandPool) != VK_SUCCESS)
 		{
 			throw std::runtime_error("failed to create command pool!");
 		}
 	}
 
+	void createGpuProfiler()
+	{
+		TRACE_SCOPE("createGpuProfiler");
+
+		if (!m_options.profileGpu) {
+			return;
+		}
+
+		const QueueFamilyIndices& queueFamilyIndices = m_deviceCapabilities.queueFamilyIndices;
+		m_gpuProfiler.create(m_vkLogicalDevice, m_vkPhysicalDevice, queueFamilyIndices.graphicsFamily.value(), gpuProfilerSlotCount(), m_hostAllocator.callbacks());
+	}
+
+	//Static command buffers are replayed per swap chain image, so they need a query slot per image.
+	//Frames in flight is fixed for the run, the image count can change with every swap chain.
+	uint32_t gpuProfilerSlotCount() const
+	{
+		return std::max(m_framesInFlight, static_cast<uint32_t>(m_swapChainImages.size()));
+	}
+
+	uint32_t profilerSlot(uint32_t imageIndex_) const
+	{
+		return m_options.recordPerFrame ? static_cast<uint32_t>(m_currentFrame) : imageIndex_;
+	}
+
 	void createCommandBuffers()
 	{
+		TRACE_SCOPE("createCommandBuffers");
+
+		//Per frame recording allocates its command buffers from the frame command pools instead
+		if (m_options.recordPerFrame) {
+			return;
+		}
+
 		m_commandBuffers.resize(m_swapChainFramebuffers.size());
 
 		VkCommandBufferAllocateInfo allocInfo = {};
@@ -643,48 +1627,298 @@ private:
 			throw std::runtime_error("failed to allocate command buffers!");
 		}
 
+		//Every image records the same draws, so they all share the ring's last region. Threaded recording implies per frame
+		//recording, so these are recorded on this thread alone and each draw's push lands at the same offset every time.
+		//Re-recording after a resize then writes the same bytes to the same places while older buffers may still read them.
+		if (m_threadPool) {
+			throw std::runtime_error("static command buffers must be recorded on one thread [::createCommandBuffers]");
+		}
 		for (size_t i = 0; i < m_commandBuffers.size(); i++) {
+			m_uniformRing.beginFrame(m_framesInFlight);
+			recordCommandBuffer(m_commandBuffers[i], static_cast<uint32_t>(i), 0);
+		}
+		
+	}
+
+	void createFrameCommandPools()
+	{
+		TRACE_SCOPE("createFrameCommandPools");
+
+		if (!m_options.recordPerFrame) {
+			return;
+		}
+
+		const QueueFamilyIndices& queueFamilyIndices = m_deviceCapabilities.queueFamilyIndices;
+
+		//One transient pool per frame in flight, reset as a whole once the frame's fence has signalled
+		m_frameCommandPools.resize(m_framesInFlight);
+		m_frameCommandBuffers.resize(m_framesInFlight);
+
+		for (size_t i = 0; i < m_framesInFlight; i++) {
+			VkCommandPoolCreateInfo poolInfo = {};
+			poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+			poolInfo.queueFamilyIndex = queueFamilyIndices.graphicsFamily.value();
+			poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+
+			if (vkCreateCommandPool(m_vkLogicalDevice, &poolInfo, m_hostAllocator.callbacks(), &m_frameCommandPools[i]) != VK_SUCCESS)
+			{
+				throw std::runtime_error("failed to create frame command pool!");
+			}
+
+			VkCommandBufferAllocateInfo allocInfo = {};
+			allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+			allocInfo.commandPool = m_frameCommandPools[i];
+			allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+			allocInfo.commandBufferCount = 1;
+
+			if (vkAllocateCommandBuffers(m_vkLogicalDevice, &allocInfo, &m_frameCommandBuffers[i]) != VK_SUCCESS) {
+				throw std::runtime_error("failed to allocate frame command buffer!");
+			}
+		}
+	}
+
+	void createWorkerCommandPools(uint32_t threadCount_)
+	{
+		TRACE_SCOPE("createWorkerCommandPools");
+
+		if (threadCount_ == 0) {
+			return;
+		}
+
+		m_threadPool = std::make_unique<ThreadPool>(threadCount_);
+
+		const QueueFamilyIndices& queueFamilyIndices = m_deviceCapabilities.queueFamilyIndices;
+
+		//Command pools are externally synchronized, so every worker gets its own pool per frame in flight
+		m_workerCommandPools.resize(m_framesInFlight * threadCount_);
+		for (auto& workerPool : m_workerCommandPools) {
+			VkCommandPoolCreateInfo poolInfo = {};
+			poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+			poolInfo.queueFamilyIndex = queueFamilyIndices.graphicsFamily.value();
+			poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+
+			if (vkCreateCommandPool(m_vkLogicalDevice, &poolInfo, m_hostAllocator.callbacks(), &workerPool.commandPool) != VK_SUCCESS)
+			{
+				throw std::runtime_error("failed to create worker command pool!");
+			}
+		}
+	}
+
+	void destroyWorkerCommandPools()
+	{
+		m_threadPool.reset();
+
+		for (auto& workerPool : m_workerCommandPools) {
+			vkDestroyCommandPool(m_vkLogicalDevice, workerPool.commandPool, m_hostAllocator.callbacks());
+		}
+		m_workerCommandPools.clear();
+	}
+
+	void recordCommandBuffer(VkCommandBuffer commandBuffer_, uint32_t imageIndex_, VkCommandBufferUsageFlags usage_)
+	{
+		VkCommandBufferBeginInfo beginInfo = {};
+		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		beginInfo.flags = usage_;
+		beginInfo.pInheritanceInfo = nullptr;
+
+		if (vkBeginCommandBuffer(commandBuffer_, &beginInfo) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to begin recording command buffer!");
+		}
+
+		uint32_t querySlot = profilerSlot(imageIndex_);
+		m_gpuProfiler.beginFrame(commandBuffer_, querySlot);
+
+		if (m_renderGraph) {
+			uint32_t renderGraphScope = m_gpuProfiler.beginScope(commandBuffer_, querySlot, "render graph");
+
+			//The thread scaling benchmark switches between inline and threaded recording
+			m_renderGraph->setContents(m_scenePass, m_threadPool ? VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS : VK_SUBPASS_CONTENTS_INLINE);
+			m_renderGraph->bindImported(m_backbuffer, m_swapChainImages[imageIndex_], m_swapChainImageViews[imageIndex_]);
+			m_renderGraph->execute(commandBuffer_);
+
+			m_gpuProfiler.endScope(commandBuffer_, querySlot, renderGraphScope);
+			if (vkEndCommandBuffer(commandBuffer_) != VK_SUCCESS) {
+				throw std::runtime_error("failed to recrod command buffer!");
+			}
+			return;
+		}
+
+		uint32_t renderPassScope = m_gpuProfiler.beginScope(commandBuffer_, querySlot, "render pass");
+
+		VkRenderPassBeginInfo renderPassInfo = {};
+		renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+		renderPassInfo.renderPass = m_renderPass;
+		renderPassInfo.framebuffer = m_swapChainFramebuffers[imageIndex_];
+		renderPassInfo.renderArea.offset = { 0,0 };
+		renderPassInfo.renderArea.extent = m_swapChainExtent;
+
+		VkClearValue clearColor = { 0.f, 0.f, 0.f, 1.f };
+		renderPassInfo.clearValueCount = 1;
+		renderPassInfo.pClearValues = &clearColor;
+
+		if (m_threadPool) {
+			vkCmdBeginRenderPass(commandBuffer_, &renderPassInfo, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+			recordSecondaryCommandBuffers(commandBuffer_, m_renderPass, m_swapChainFramebuffers[imageIndex_]);
+		}
+		else {
+			vkCmdBeginRenderPass(commandBuffer_, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+			recordDraws(commandBuffer_, 0, m_options.drawCount);
+		}
+
+		vkCmdEndRenderPass(commandBuffer_);
+
+		m_gpuProfiler.endScope(commandBuffer_, querySlot, renderPassScope);
+
+		if (vkEndCommandBuffer(commandBuffer_) != VK_SUCCESS) {
+			throw std::runtime_error("failed to recrod command buffer!");
+		}
+	}
+
+	//Splits the draw list across the worker threads, each recording one secondary command buffer
+	void recordSecondaryCommandBuffers(VkCommandBuffer primaryCommandBuffer_, VkRenderPass renderPass_, VkFramebuffer framebuffer_)
+	{
+		uint32_t taskCount = m_threadPool->threadCount();
+		std::vector<VkCommandBuffer> secondaryCommandBuffers(taskCount);
+
+		m_threadPool->parallelFor(taskCount, [&](uint32_t taskIndex_, uint32_t workerIndex_) {
+			TRACE_SCOPE("recordSecondaryCommandBuffer");
+
+			WorkerCommandPool& workerPool = m_workerCommandPools[m_currentFrame * taskCount + workerIndex_];
+
+			//Buffers survive vkResetCommandPool, so only allocate when this worker needs more than before
+			if (workerPool.usedCount == workerPool.commandBuffers.size()) {
+				VkCommandBufferAllocateInfo allocInfo = {};
+				allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+				allocInfo.commandPool = workerPool.commandPool;
+				allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+				allocInfo.commandBufferCount = 1;
+
+				VkCommandBuffer commandBuffer;
+				if (vkAllocateCommandBuffers(m_vkLogicalDevice, &allocInfo, &commandBuffer) != VK_SUCCESS) {
+					throw std::runtime_error("failed to allocate secondary command buffer!");
+				}
+				workerPool.commandBuffers.push_back(commandBuffer);
+			}
+			VkCommandBuffer commandBuffer = workerPool.commandBuffers[workerPool.usedCount++];
+
+			VkCommandBufferInheritanceInfo inheritanceInfo = {};
+			inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+			inheritanceInfo.renderPass = renderPass_;
+			inheritanceInfo.subpass = 0;
+			inheritanceInfo.framebuffer = framebuffer_;
+
 			VkCommandBufferBeginInfo beginInfo = {};
 			beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-			beginInfo.flags = 0;
-			beginInfo.pInheritanceInfo = nullptr;
+			beginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT | VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+			beginInfo.pInheritanceInfo = &inheritanceInfo;
 
-			if (vkBeginCommandBuffer(m_commandBuffers[i], &beginInfo) != VK_SUCCESS)
+			if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS)
 			{
-				throw std::runtime_error("failed to begin recording command buffer!");
+				throw std::runtime_error("failed to begin recording secondary command buffer!");
 			}
 
-			VkRenderPassBeginInfo renderPassInfo = {};
-			renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-			renderPassInfo.renderPass = m_renderPass;
-			renderPassInfo.framebuffer = m_swapChainFramebuffers[i];
-			renderPassInfo.renderArea.offset = { 0,0 };
-			renderPassInfo.renderArea.extent = m_swapChainExtent;
+			uint32_t firstDraw = static_cast<uint32_t>(uint64_t(m_options.drawCount) * taskIndex_ / taskCount);
+			uint32_t lastDraw = static_cast<uint32_t>(uint64_t(m_options.drawCount) * (taskIndex_ + 1) / taskCount);
+			recordDraws(commandBuffer, firstDraw, lastDraw - firstDraw);
+
+			if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+				throw std::runtime_error("failed to record secondary command buffer!");
+			}
 
-			VkClearValue clearColor = { 0.f, 0.f, 0.f, 1.f };
-			renderPassInfo.clearValueCount = 1;
-			renderPassInfo.pClearValues = &clearColor;
+			secondaryCommandBuffers[taskIndex_] = commandBuffer;
+		});
 
-			vkCmdBeginRenderPass(m_commandBuffers[i], &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+		vkCmdExecuteCommands(primaryCommandBuffer_, taskCount, secondaryCommandBuffers.data());
+	}
 
-			vkCmdBindPipeline(m_commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, m_graphicsPipeline);
-			vkCmdDraw(m_commandBuffers[i], 3, 1, 0, 0);
+	void recordDraws(VkCommandBuffer commandBuffer_, uint32_t firstDraw_, uint32_t drawCount_)
+	{
+		//Pipeline still building on the pipeline compiler, the render pass only clears this frame
+		if (m_graphicsPipeline == VK_NULL_HANDLE) {
+			return;
+		}
 
-			vkCmdEndRenderPass(m_commandBuffers[i]);
+		vkCmdBindPipeline(commandBuffer_, VK_PIPELINE_BIND_POINT_GRAPHICS, m_graphicsPipeline);
 
-			if (vkEndCommandBuffer(m_commandBuffers[i]) != VK_SUCCESS) {
-				throw std::runtime_error("failed to recrod command buffer!");
+		VkViewport viewport = {};
+		viewport.x = 0.0f;
+		viewport.y = 0.0f;
+		viewport.width = (float)m_swapChainExtent.width;
+		viewport.height = (float)m_swapChainExtent.height;
+		viewport.minDepth = 0.0f;
+		viewport.maxDepth = 1.0f;
+		vkCmdSetViewport(commandBuffer_, 0, 1, &viewport);
+
+		VkRect2D scissor = {};
+		scissor.offset = { 0,0 };
+		scissor.extent = m_swapChainExtent;
+		vkCmdSetScissor(commandBuffer_, 0, 1, &scissor);
+
+		//Bindings are not inherited by secondary command buffers, so every buffer binds its own
+		VkBuffer vertexBuffers[] = { m_vertexBuffer, m_instanceBuffer };
+		VkDeviceSize offsets[] = { 0, 0 };
+		vkCmdBindVertexBuffers(commandBuffer_, 0, m_options.instanced ? 2 : 1, vertexBuffers, offsets);
+		vkCmdBindIndexBuffer(commandBuffer_, m_indexBuffer, 0, VK_INDEX_TYPE_UINT16);
+
+		//Draws are instances [firstDraw_, firstDraw_ + drawCount_) of the per instance stream, no per draw data to feed
+		if (m_options.instanced) {
+			if (m_drawPerInstance) {
+				for (uint32_t i = 0; i < drawCount_; i++) {
+					drawInstanced(commandBuffer_, m_instanceIndexCount, firstDraw_ + i, 1);
+				}
+				m_drawCallCount.fetch_add(drawCount_, std::memory_order_relaxed);
 			}
+			else {
+				drawInstanced(commandBuffer_, m_instanceIndexCount, firstDraw_, drawCount_);
+				m_drawCallCount.fetch_add(1, std::memory_order_relaxed);
+			}
+			return;
+		}
+		m_drawCallCount.fetch_add(drawCount_, std::memory_order_relaxed);
+
+		uint32_t columns = gridColumns(m_options.drawCount);
+
+		//One bind for the whole command buffer, a draw pushes its data's place in the bindless storage buffer array
+		if (m_bindlessEnabled) {
+			VkDescriptorSet bindlessSet = m_bindlessTable.set();
+			vkCmdBindDescriptorSets(commandBuffer_, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipelineLayout, 0, 1, &bindlessSet, 0, nullptr);
+
+			BindlessDrawConstants constants = {};
+			constants.drawBuffer = m_drawBufferIndex;
+			for (uint32_t i = 0; i < drawCount_; i++) {
+				//Offsets are multiples of the aligned DrawUniforms size, so they are whole elements of the array
+				constants.drawIndex = static_cast<uint32_t>(m_uniformRing.push(drawUniforms(firstDraw_ + i, columns)) / sizeof(DrawUniforms));
+				vkCmdPushConstants(commandBuffer_, m_pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(constants), &constants);
+				vkCmdDrawIndexed(commandBuffer_, static_cast<uint32_t>(quadIndices.size()), 1, 0, 0, 0);
+			}
+			return;
+		}
+
+		//One push into the uniform ring per draw, the descriptor set stays the same and only its dynamic offset moves
+		for (uint32_t i = 0; i < drawCount_; i++) {
+			uint32_t dynamicOffset = m_uniformRing.push(drawUniforms(firstDraw_ + i, columns));
+			vkCmdBindDescriptorSets(commandBuffer_, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipelineLayout, 0, 1, &m_uniformDescriptorSet, 1, &dynamicOffset);
+			vkCmdDrawIndexed(commandBuffer_, static_cast<uint32_t>(quadIndices.size()), 1, 0, 0, 0);
 		}
-		
+	}
+
+	//Packs instanceCount_ copies of the bound mesh into one draw, copy i reads element firstInstance_ + i of the per
+	//instance stream. The mesh is the first indexCount_ indices of the bound index buffer.
+	void drawInstanced(VkCommandBuffer commandBuffer_, uint32_t indexCount_, uint32_t firstInstance_, uint32_t instanceCount_)
+	{
+		vkCmdDrawIndexed(commandBuffer_, indexCount_, instanceCount_, 0, 0, firstInstance_);
 	}
 
 	void createSyncObjects()
 	{
-		m_imageAvailableSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-		m_renderFinishedSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-		m_inFLightFences.resize(MAX_FRAMES_IN_FLIGHT);
+		TRACE_SCOPE("createSyncObjects");
+
+		m_imageAvailableSemaphores.resize(m_framesInFlight);
+		m_renderFinishedSemaphores.resize(m_framesInFlight);
+		m_frameSubmissions.assign(m_framesInFlight, 0);
 		m_imagesInFlight.resize(m_swapChainImages.size(), VK_NULL_HANDLE);
+		m_imageSubmissions.assign(m_swapChainImages.size(), 0);
 
 		VkSemaphoreCreateInfo semaphoreInfo = {};
 		semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
@@ -693,16 +1927,41 @@ private:
 		fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
 		fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
 
-		for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) 
+		for (size_t i = 0; i < m_framesInFlight; i++) 
 		{
-			if (vkCreateSemaphore(m_vkLogicalDevice, &semaphoreInfo, nullptr, &m_imageAvailableSemaphores[i]) != VK_SUCCESS
-				|| vkCreateSemaphore(m_vkLogicalDevice, &semaphoreInfo, nullptr, &m_renderFinishedSemaphores[i]) != VK_SUCCESS
-				|| vkCreateFence(m_vkLogicalDevice, &fenceInfo, nullptr, &m_inFLightFences[i]) != VK_SUCCESS
+			if (vkCreateSemaphore(m_vkLogicalDevice, &semaphoreInfo, m_hostAllocator.callbacks(), &m_imageAvailableSemaphores[i]) != VK_SUCCESS
+				|| vkCreateSemaphore(m_vkLogicalDevice, &semaphoreInfo, m_hostAllocator.callbacks(), &m_renderFinishedSemaphores[i]) != VK_SUCCESS
 				)
 			{
 				throw std::runtime_error("failed to create semaphores!");
 			}
 		}
+
+		//Acquire and present only accept binary semaphores, frame completion is tracked by one timeline
+		//counter on the graphics queue which frame N signals with value N
+		if (m_timelineSemaphoresEnabled) {
+			VkSemaphoreTypeCreateInfoKHR typeInfo = {};
+			typeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO_KHR;
+			typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE_KHR;
+			typeInfo.initialValue = 0;
+
+			VkSemaphoreCreateInfo timelineInfo = {};
+			timelineInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+			timelineInfo.pNext = &typeInfo;
+
+			if (vkCreateSemaphore(m_vkLogicalDevice, &timelineInfo, m_hostAllocator.callbacks(), &m_frameTimeline) != VK_SUCCESS) {
+				throw std::runtime_error("failed to create timeline semaphore!");
+			}
+			return;
+		}
+
+		m_inFLightFences.resize(m_framesInFlight);
+		for (size_t i = 0; i < m_framesInFlight; i++)
+		{
+			if (vkCreateFence(m_vkLogicalDevice, &fenceInfo, m_hostAllocator.callbacks(), &m_inFLightFences[i]) != VK_SUCCESS) {
+				throw std::runtime_error("failed to create fences!");
+			}
+		}
 		
 	}	
 
@@ -736,13 +1995,17 @@ private:
 	}
 
 	std::vector<const char*> getRequiredExtensions() {
+		//Add more extensions here
+		std::vector<const char*> extensions;
+
 		//Get the required extension for GLFW window system
-		uint32_t glfwExtensionCount = 0;
-		const char** glfwExtensions;
-		glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+		if (!m_options.headless) {
+			uint32_t glfwExtensionCount = 0;
+			const char** glfwExtensions;
+			glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
 
-		//Add more extensions here
-		std::vector<const char*> extensions(glfwExtensions, glfwExtensions + glfwExtensionCount);
+			extensions.assign(glfwExtensions, glfwExtensions + glfwExtensionCount);
+		}
 
 		if (enableValidationLayers) {
 			extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
@@ -784,104 +2047,292 @@ private:
 	//////////////////////////////  Functions to Support Debug Messenger Setup : setupDebugMessenger()
 	void populateDebugMessengerCreateInfo(VkDebugUtilsMessengerCreateInfoEXT& createInfo_) {
 		createInfo_.sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_MESSENGER_CREATE_INFO_EXT;
-		createInfo_.messageSeverity = VK_DEBUG_UTILS_MESSAGE_SEVERITY_VERBOSE_BIT_EXT
-			| VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT
-			| VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT;
-		createInfo_.messageType = VK_DEBUG_UTILS_MESSAGE_TYPE_GENERAL_BIT_EXT
-			| VK_DEBUG_UTILS_MESSAGE_TYPE_VALIDATION_BIT_EXT
-			| VK_DEBUG_UTILS_MESSAGE_TYPE_PERFORMANCE_BIT_EXT;
-
-		createInfo_.pfnUserCallback = debugCallback;
+		//Filtered severities are not even generated by the layers, the sink can narrow them further at runtime
+		createInfo_.messageSeverity = m_debugSink.severityMask();
+		createInfo_.messageType = m_debugSink.typeMask();
+
+		//Messages are queued and printed by the sink's own thread
+		createInfo_.pfnUserCallback = DebugMessageSink::callback;
+		createInfo_.pUserData = &m_debugSink;
 		createInfo_.pNext = nullptr;
 		createInfo_.flags = 0;
 	}
 
-	static VKAPI_ATTR VkBool32 VKAPI_CALL debugCallback(
-		VkDebugUtilsMessageSeverityFlagBitsEXT messageSeverity_,
-		VkDebugUtilsMessageTypeFlagsEXT messageType_,
-		const VkDebugUtilsMessengerCallbackDataEXT* pCallbackData,
-		void* pUserData) {
-
-		//Print debug message which caused the callback
-		std::cerr << "validation layer: " << pCallbackData->pMessage << std::endl;
-
-		//return false to not abort the vulkan call that triggered this callback
-		return VK_FALSE;
-		return VK_FALSE;
-	}
-
 	//////////////////////////////////////////////////////////////////////////////////////////////////////
 	//////////////////////////////  Functions to Support Pyhsical Device Selection : pickPhysicalDevice()
-	bool isDeviceSuitable(VkPhysicalDevice device_) {
-		QueueFamilyIndices indices = findQueueFamilies(device_);
-
-		bool extensionSupported = checkDeviceExtensionSupport(device_);
-
-		bool swapChainAdequate = false;
-		if (extensionSupported) {
-			SwapChainSupportDetails swapChainSupport = querySwapChainSupport(device_);
-			swapChainAdequate = !swapChainSupport.formats.empty() && !swapChainSupport.formats.empty();
-		}
-
-		return indices.isComplete() && extensionSupported && swapChainAdequate;
-	}
-
 	struct QueueFamilyIndices {
 		std::optional<uint32_t> graphicsFamily;
 		std::optional<uint32_t> presentFamily;
 
-		bool isComplete() {
+		//A transfer only family if the device has one (usually a DMA engine), the graphics family otherwise
+		std::optional<uint32_t> transferFamily;
+
+		//A compute family without graphics for async compute, the graphics family otherwise
+		std::optional<uint32_t> computeFamily;
+
+		bool isComplete() const {
 			return graphicsFamily.has_value() && presentFamily.has_value();
 		}
 
 	};
 
-	QueueFamilyIndices findQueueFamilies(VkPhysicalDevice device_) {
-		QueueFamilyIndices indices;
+	//Everything selection and the later setup need to know about one physical device, queried once by probeDevice()
+	struct DeviceCapabilities {
+		VkPhysicalDevice device = VK_NULL_HANDLE;
+		VkPhysicalDeviceProperties properties = {};
+		VkPhysicalDeviceFeatures features = {};
+		VkPhysicalDeviceMemoryProperties memoryProperties = {};
+		std::vector<VkQueueFamilyProperties> queueFamilies;
+		QueueFamilyIndices queueFamilyIndices;
+		std::set<std::string> extensions;
+
+		//Fixed for a surface, unlike its capabilities which change with the window size
+		std::vector<VkSurfaceFormatKHR> surfaceFormats;
+		std::vector<VkPresentModeKHR> presentModes;
+
+		VkDeviceSize deviceLocalBytes = 0;
+		bool timelineSemaphore = false;
+		bool descriptorIndexing = false;
+		uint32_t bindlessStorageBuffers = 0;	//Array sizes for the bindless table, within the update after bind limits
+		uint32_t bindlessSampledImages = 0;
+		bool suitable = false;
+		int64_t score = 0;
+	};
+
+	DeviceCapabilities probeDevice(VkPhysicalDevice device_)
+	{
+		DeviceCapabilities capabilities;
+		capabilities.device = device_;
+		vkGetPhysicalDeviceProperties(device_, &capabilities.properties);
+		vkGetPhysicalDeviceFeatures(device_, &capabilities.features);
+		vkGetPhysicalDeviceMemoryProperties(device_, &capabilities.memoryProperties);
 
-		// Logic to find graphics queue family
 		uint32_t queueFamilyCount = 0;
 		vkGetPhysicalDeviceQueueFamilyProperties(device_, &queueFamilyCount, nullptr);
+		capabilities.queueFamilies.resize(queueFamilyCount);
+		vkGetPhysicalDeviceQueueFamilyProperties(device_, &queueFamilyCount, capabilities.queueFamilies.data());
+		capabilities.queueFamilyIndices = findQueueFamilies(device_, capabilities.queueFamilies);
 
-		std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
-		vkGetPhysicalDeviceQueueFamilyProperties(device_, &queueFamilyCount, queueFamilies.data());
+		uint32_t extensionCount = 0;
+		vkEnumerateDeviceExtensionProperties(device_, nullptr, &extensionCount, nullptr);
+		std::vector<VkExtensionProperties> extensions(extensionCount);
+		vkEnumerateDeviceExtensionProperties(device_, nullptr, &extensionCount, extensions.data());
+		for (const auto& extension : extensions) {
+			capabilities.extensions.insert(extension.extensionName);
+		}
 
-		int i = 0;
-		for (const auto& queueFamily : queueFamilies) {
-			if (queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) {
-				indices.graphicsFamily = i;
-			}
+		if (!m_options.headless && capabilities.extensions.count(VK_KHR_SWAPCHAIN_EXTENSION_NAME)) {
+			uint32_t formatCount = 0;
+			vkGetPhysicalDeviceSurfaceFormatsKHR(device_, m_vkSurface, &formatCount, nullptr);
+			capabilities.surfaceFormats.resize(formatCount);
+			vkGetPhysicalDeviceSurfaceFormatsKHR(device_, m_vkSurface, &formatCount, capabilities.surfaceFormats.data());
 
-			VkBool32 presentSupport = false;
-			vkGetPhysicalDeviceSurfaceSupportKHR(device_, i, m_vkSurface, &presentSupport);
-			if (presentSupport) {
-				indices.presentFamily = i;
-			}
+			uint32_t presentModeCount = 0;
+			vkGetPhysicalDeviceSurfacePresentModesKHR(device_, m_vkSurface, &presentModeCount, nullptr);
+			capabilities.presentModes.resize(presentModeCount);
+			vkGetPhysicalDeviceSurfacePresentModesKHR(device_, m_vkSurface, &presentModeCount, capabilities.presentModes.data());
+		}
 
-			if (indices.isComplete()) {
-				break;
+		//Integrated GPUs often expose several small device local heaps, the largest one is what we can count on
+		for (uint32_t i = 0; i < capabilities.memoryProperties.memoryHeapCount; i++) {
+			const VkMemoryHeap& heap = capabilities.memoryProperties.memoryHeaps[i];
+			if (heap.flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) {
+				capabilities.deviceLocalBytes = std::max(capabilities.deviceLocalBytes, heap.size);
 			}
-
+		}
+
+		//Needs vkGetPhysicalDeviceFeatures2, only available when the instance was created for Vulkan 1.1
+		if (m_options.timelineSemaphores && capabilities.extensions.count(VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME)) {
+			capabilities.timelineSemaphore = isTimelineSemaphoreSupported(device_);
+		}
+		if (m_options.bindless && capabilities.extensions.count(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME)
+			&& capabilities.extensions.count(VK_KHR_MAINTENANCE3_EXTENSION_NAME)) {
+			probeDescriptorIndexing(device_, capabilities);
+		}
+
+		capabilities.suitable = isDeviceSuitable(capabilities);
+		capabilities.score = scoreDevice(capabilities);
+		return capabilities;
+	}
+
+	bool isDeviceSuitable(const DeviceCapabilities& capabilities_) {
+		if (!capabilities_.queueFamilyIndices.isComplete()) {
+			return false;
+		}
+
+		//Descriptor indexing is not required, bindless mode falls back to per draw binds and scoreDevice() prefers
+		//devices that can do it. createLogicalDevice() reports the fallback for the selected device.
+
+		//Headless rendering only needs a graphics queue, no presentation support
+		if (m_options.headless) {
+			return true;
+		}
+
+		bool extensionSupported = checkDeviceExtensionSupport(capabilities_);
+		bool swapChainAdequate = !capabilities_.surfaceFormats.empty() && !capabilities_.presentModes.empty();
+
+		return extensionSupported && swapChainAdequate;
+	}
+
+	//Device type first, then the size of the largest device local heap in MiB. With --bindless, devices supporting
+	//descriptor indexing come before all others.
+	int64_t scoreDevice(const DeviceCapabilities& capabilities_)
+	{
+		int64_t typeRank = 0;
+		switch (capabilities_.properties.deviceType) {
+		case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU: typeRank = 4; break;
+		case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU: typeRank = 3; break;
+		case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU: typeRank = 2; break;
+		case VK_PHYSICAL_DEVICE_TYPE_CPU: typeRank = 1; break;
+		default: break;
+		}
+
+		const int64_t MAX_HEAP_MIB = 1 << 30;
+		int64_t heapMiB = std::min(MAX_HEAP_MIB - 1, static_cast<int64_t>(capabilities_.deviceLocalBytes / (1024 * 1024)));
+		int64_t bindlessRank = (m_options.bindless && capabilities_.descriptorIndexing) ? 8 : 0;
+		return (bindlessRank + typeRank) * MAX_HEAP_MIB + heapMiB;
+	}
+
+	//The override is either the device index or a part of its name
+	bool matchesDeviceOverride(const DeviceCapabilities& capabilities_, size_t index_, const std::string& override_)
+	{
+		bool isIndex = override_.find_first_not_of("0123456789") == std::string::npos;
+		if (isIndex) {
+			//More digits than any index has saturate instead of throwing, and match no device
+			errno = 0;
+			unsigned long long value = std::strtoull(override_.c_str(), nullptr, 10);
+			return errno != ERANGE && value == index_;
+		}
+		return std::string(capabilities_.properties.deviceName).find(override_) != std::string::npos;
+	}
+
+	static const char* deviceTypeName(VkPhysicalDeviceType type_)
+	{
+		switch (type_) {
+		case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU: return "discrete";
+		case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU: return "integrated";
+		case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU: return "virtual";
+		case VK_PHYSICAL_DEVICE_TYPE_CPU: return "cpu";
+		default: return "other";
+		}
+	}
+
+	QueueFamilyIndices findQueueFamilies(VkPhysicalDevice device_, const std::vector<VkQueueFamilyProperties>& queueFamilies_) {
+		QueueFamilyIndices indices;
+
+		// Logic to find graphics queue family
+		uint32_t i = 0;
+		for (const auto& queueFamily : queueFamilies_) {
+			//The loop may run past the first complete match, keep the first families found
+			if ((queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) && !indices.graphicsFamily.has_value()) {
+				indices.graphicsFamily = i;
+			}
+
+			bool transferOnly = (queueFamily.queueFlags & VK_QUEUE_TRANSFER_BIT)
+				&& !(queueFamily.queueFlags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT));
+			if (transferOnly && !indices.transferFamily.has_value()) {
+				indices.transferFamily = i;
+			}
+
+			bool asyncCompute = (queueFamily.queueFlags & VK_QUEUE_COMPUTE_BIT) && !(queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT);
+			if (asyncCompute && !indices.computeFamily.has_value()) {
+				indices.computeFamily = i;
+			}
+
+			//Without a surface nothing is presented, the graphics queue doubles as present queue
+			VkBool32 presentSupport = false;
+			if (m_options.headless) {
+				presentSupport = (queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) != 0;
+			}
+			else {
+				vkGetPhysicalDeviceSurfaceSupportKHR(device_, i, m_vkSurface, &presentSupport);
+			}
+			if (presentSupport && !indices.presentFamily.has_value()) {
+				indices.presentFamily = i;
+			}
+
+			//Keep looking for dedicated transfer and compute families, they tend to come after the graphics one
+			if (indices.isComplete() && indices.transferFamily.has_value() && indices.computeFamily.has_value()) {
+				break;
+			}
+
+			i++;
+		}
+
+		//Graphics queues always support transfers, and compute as well on every device we can render with
+		if (!indices.transferFamily.has_value()) {
+			indices.transferFamily = indices.graphicsFamily;
+		}
+		if (!indices.computeFamily.has_value()) {
+			indices.computeFamily = indices.graphicsFamily;
 		}
 
 		return indices;
 	}
 
-	bool checkDeviceExtensionSupport(VkPhysicalDevice device_)
+	bool checkDeviceExtensionSupport(const DeviceCapabilities& capabilities_)
 	{
-		uint32_t extensionCount;
-		vkEnumerateDeviceExtensionProperties(device_, nullptr, &extensionCount, nullptr);
+		for (const char* extension : deviceExtensions) {
+			if (!capabilities_.extensions.count(extension)) {
+				return false;
+			}
+		}
 
-		std::vector<VkExtensionProperties> availableExtensions(extensionCount);
-		vkEnumerateDeviceExtensionProperties(device_, nullptr, &extensionCount, availableExtensions.data());
+		return true;
+	}
 
-		std::set<std::string> requiredExtensions(deviceExtensions.begin(), deviceExtensions.end());
+	bool isTimelineSemaphoreSupported(VkPhysicalDevice device_)
+	{
+		VkPhysicalDeviceTimelineSemaphoreFeaturesKHR timelineFeatures = {};
+		timelineFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES_KHR;
 
-		for (const auto& extensions : availableExtensions) {
-			requiredExtensions.erase(extensions.extensionName);
+		VkPhysicalDeviceFeatures2 features = {};
+		features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+		features.pNext = &timelineFeatures;
+		vkGetPhysicalDeviceFeatures2(device_, &features);
+
+		return timelineFeatures.timelineSemaphore == VK_TRUE;
+	}
+
+	//Fills in descriptorIndexing and the bindless array sizes, needs vkGetPhysicalDeviceFeatures2 like timeline semaphores
+	void probeDescriptorIndexing(VkPhysicalDevice device_, DeviceCapabilities& capabilities_)
+	{
+		VkPhysicalDeviceDescriptorIndexingFeaturesEXT indexingFeatures = {};
+		indexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+
+		VkPhysicalDeviceFeatures2 features = {};
+		features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+		features.pNext = &indexingFeatures;
+		vkGetPhysicalDeviceFeatures2(device_, &features);
+
+		VkPhysicalDeviceDescriptorIndexingPropertiesEXT indexingProperties = {};
+		indexingProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES_EXT;
+
+		VkPhysicalDeviceProperties2 properties = {};
+		properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+		properties.pNext = &indexingProperties;
+		vkGetPhysicalDeviceProperties2(device_, &properties);
+
+		bool supported = features.features.shaderStorageBufferArrayDynamicIndexing
+			&& features.features.shaderSampledImageArrayDynamicIndexing
+			&& indexingFeatures.runtimeDescriptorArray
+			&& indexingFeatures.descriptorBindingPartiallyBound
+			&& indexingFeatures.descriptorBindingStorageBufferUpdateAfterBind
+			&& indexingFeatures.descriptorBindingSampledImageUpdateAfterBind;
+		if (!supported) {
+			return;
 		}
 
-		return requiredExtensions.empty();
+		//Both arrays are visible to the fragment stage, so they share its resource limit
+		capabilities_.bindlessStorageBuffers = std::min({ BINDLESS_STORAGE_BUFFERS,
+			indexingProperties.maxPerStageDescriptorUpdateAfterBindStorageBuffers,
+			indexingProperties.maxDescriptorSetUpdateAfterBindStorageBuffers,
+			indexingProperties.maxPerStageUpdateAfterBindResources / 2 });
+		capabilities_.bindlessSampledImages = std::min({ BINDLESS_SAMPLED_IMAGES,
+			indexingProperties.maxPerStageDescriptorUpdateAfterBindSampledImages,
+			indexingProperties.maxDescriptorSetUpdateAfterBindSampledImages,
+			indexingProperties.maxPerStageUpdateAfterBindResources - capabilities_.bindlessStorageBuffers });
+		capabilities_.descriptorIndexing = capabilities_.bindlessStorageBuffers > 0 && capabilities_.bindlessSampledImages > 0;
 	}
 
 	//////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -892,26 +2343,12 @@ private:
 		std::vector<VkPresentModeKHR> presentModes;
 	};
 
-	SwapChainSupportDetails querySwapChainSupport(VkPhysicalDevice device_) {
+	//Formats and present modes come from the capability cache, the surface capabilities follow the window size and are queried every time
+	SwapChainSupportDetails querySwapChainSupport() {
 		SwapChainSupportDetails details;
-		vkGetPhysicalDeviceSurfaceCapabilitiesKHR(device_, m_vkSurface, &details.capabilities);
-
-		uint32_t formatCount;
-		vkGetPhysicalDeviceSurfaceFormatsKHR(device_, m_vkSurface, &formatCount, nullptr);
-
-		if (formatCount != 0)
-		{
-			details.formats.resize(formatCount);
-			vkGetPhysicalDeviceSurfaceFormatsKHR(device_, m_vkSurface, &formatCount, details.formats.data());
-		}
-
-		uint32_t presentModeCount = 0;
-		vkGetPhysicalDeviceSurfacePresentModesKHR(device_, m_vkSurface, &formatCount, nullptr);
-
-		if (formatCount != 0) {
-			details.presentModes.resize(presentModeCount);
-			vkGetPhysicalDeviceSurfacePresentModesKHR(device_, m_vkSurface, &formatCount, details.presentModes.data());
-		}
+		vkGetPhysicalDeviceSurfaceCapabilitiesKHR(m_vkPhysicalDevice, m_vkSurface, &details.capabilities);
+		details.formats = m_deviceCapabilities.surfaceFormats;
+		details.presentModes = m_deviceCapabilities.presentModes;
 
 		return details;
 	}
@@ -959,27 +2396,117 @@ private:
 
 	void cleanupSwapChain()
 	{
+		if (m_renderGraph) {
+			m_renderGraph->destroy();
+			m_renderGraph.reset();
+		}
+
 		for (auto framebuffer : m_swapChainFramebuffers)
 		{
-			vkDestroyFramebuffer(m_vkLogicalDevice, framebuffer, nullptr);
+			vkDestroyFramebuffer(m_vkLogicalDevice, framebuffer, m_hostAllocator.callbacks());
 		}
 
-		vkFreeCommandBuffers(m_vkLogicalDevice, m_commandPool, static_cast<uint32_t>(m_commandBuffers.size()), m_commandBuffers.data());
-
-		vkDestroyPipeline(m_vkLogicalDevice, m_graphicsPipeline, nullptr);
-		vkDestroyPipelineLayout(m_vkLogicalDevice, m_pipelineLayout, nullptr);
-
-		vkDestroyRenderPass(m_vkLogicalDevice, m_renderPass, nullptr);
+		if (!m_commandBuffers.empty()) {
+			vkFreeCommandBuffers(m_vkLogicalDevice, m_commandPool, static_cast<uint32_t>(m_commandBuffers.size()), m_commandBuffers.data());
+		}
 
 		for (auto imageView : m_swapChainImageViews) {
-			vkDestroyImageView(m_vkLogicalDevice, imageView, nullptr);
+			vkDestroyImageView(m_vkLogicalDevice, imageView, m_hostAllocator.callbacks());
+		}
+
+		if (m_options.headless) {
+			for (size_t i = 0; i < m_swapChainImages.size(); i++) {
+				vkDestroyImage(m_vkLogicalDevice, m_swapChainImages[i], m_hostAllocator.callbacks());
+				m_gpuAllocator.free(m_offscreenImageMemory[i]);
+			}
+			return;
 		}
 
-		vkDestroySwapchainKHR(m_vkLogicalDevice, m_swapChain, nullptr);
+		vkDestroySwapchainKHR(m_vkLogicalDevice, m_swapChain, m_hostAllocator.callbacks());
+
+	}
+
+	//Render pass and pipeline only depend on the swap chain format, not on its extent
+	void cleanupRenderPipeline()
+	{
+		vkDestroyPipeline(m_vkLogicalDevice, m_graphicsPipeline, m_hostAllocator.callbacks());
+		vkDestroyPipelineLayout(m_vkLogicalDevice, m_pipelineLayout, m_hostAllocator.callbacks());
+
+		vkDestroyRenderPass(m_vkLogicalDevice, m_renderPass, m_hostAllocator.callbacks());
+	}
+
+	//Moves the current swap chain and its dependent objects to the deferred destruction queue
+	void retireSwapChain()
+	{
+		VkDevice device = m_vkLogicalDevice;
+		const VkAllocationCallbacks* allocator = m_hostAllocator.callbacks();
+		VkCommandPool commandPool = m_commandPool;
+		VkSwapchainKHR swapChain = m_swapChain;
+		std::vector<VkFramebuffer> framebuffers = std::move(m_swapChainFramebuffers);
+		std::vector<VkCommandBuffer> commandBuffers = std::move(m_commandBuffers);
+		std::vector<VkImageView> imageViews = std::move(m_swapChainImageViews);
+		std::shared_ptr<RenderGraph> renderGraph(std::move(m_renderGraph));
+
+		deferDestruction([=]() {
+			//Its transient images have the size of the old swap chain
+			if (renderGraph) {
+				renderGraph->destroy();
+			}
+
+			for (auto framebuffer : framebuffers) {
+				vkDestroyFramebuffer(device, framebuffer, allocator);
+			}
+
+			if (!commandBuffers.empty()) {
+				vkFreeCommandBuffers(device, commandPool, static_cast<uint32_t>(commandBuffers.size()), commandBuffers.data());
+			}
+
+			for (auto imageView : imageViews) {
+				vkDestroyImageView(device, imageView, allocator);
+			}
+
+			vkDestroySwapchainKHR(device, swapChain, allocator);
+		});
+
+		m_swapChainFramebuffers.clear();
+		m_commandBuffers.clear();
+		m_swapChainImageViews.clear();
+		m_swapChain = VK_NULL_HANDLE;
+	}
+
+	void retireRenderPipeline()
+	{
+		VkDevice device = m_vkLogicalDevice;
+		const VkAllocationCallbacks* allocator = m_hostAllocator.callbacks();
+		VkPipeline pipeline = m_graphicsPipeline;
+		VkPipelineLayout pipelineLayout = m_pipelineLayout;
+		VkRenderPass renderPass = m_renderPass;
+
+		deferDestruction([=]() {
+			vkDestroyPipeline(device, pipeline, allocator);
+			vkDestroyPipelineLayout(device, pipelineLayout, allocator);
+			vkDestroyRenderPass(device, renderPass, allocator);
+		});
+	}
+
+	//Queues destruction of objects which may still be used by submitted frames.
+	//They are destroyed once every frame submitted before this call has signalled its fence.
+	void deferDestruction(std::function<void()> destroy_)
+	{
+		m_deferredDestructions.push_back({ m_submittedFrames, std::move(destroy_) });
+	}
 
+	void flushDeferredDestructions(uint64_t completedFrames_)
+	{
+		while (!m_deferredDestructions.empty() && m_deferredDestructions.front().submittedFrames <= completedFrames_) {
+			m_deferredDestructions.front().destroy();
+			m_deferredDestructions.pop_front();
+		}
 	}
 
 	void recreateSwapChain() {
+		TRACE_SCOPE("recreateSwapChain");
+
 		int width = 0, height = 0;
 		glfwGetFramebufferSize(m_window, &width, &height);
 
@@ -989,15 +2516,65 @@ private:
 			glfwWaitEvents();
 		}
 
-		vkDeviceWaitIdle(m_vkLogicalDevice);
+		auto start = std::chrono::high_resolution_clock::now();
+		uint64_t hostAllocationsBefore = m_hostAllocator.counters().totalAllocations();
 
-		cleanupSwapChain();
-		createSwapChain();
+		//No vkDeviceWaitIdle here: the old swap chain is handed to the new one as oldSwapchain and
+		//everything that frames in flight may still reference is destroyed once their fences signal
+		VkFormat previousFormat = m_swapChainImageFormat;
+		VkSwapchainKHR oldSwapChain = m_swapChain;
+
+		retireSwapChain();
+		createSwapChain(oldSwapChain);
 		createImageViews();
-		createRenderPass();
-		createGraphicsPipeline();
+
+		//Viewport and scissor are dynamic, a resize only needs a rebuild if the surface format changed
+		if (m_swapChainImageFormat != previousFormat) {
+			if (m_pendingPipeline.valid()) {
+				finishPendingPipeline();
+			}
+			retireRenderPipeline();
+			createRenderPass();
+			createGraphicsPipeline();
+		}
+
+		//The new swap chain may have more images than the profiler has slots, frames in flight may still write the old pool
+		VkQueryPool oldQueryPool = m_gpuProfiler.resize(gpuProfilerSlotCount());
+		if (oldQueryPool != VK_NULL_HANDLE) {
+			VkDevice device = m_vkLogicalDevice;
+			const VkAllocationCallbacks* allocator = m_hostAllocator.callbacks();
+			deferDestruction([=]() {
+				vkDestroyQueryPool(device, oldQueryPool, allocator);
+			});
+		}
+
 		createFramebuffers();
+		createRenderGraph();
 		createCommandBuffers();
+
+		//Images of the new swap chain have not been used by any frame yet
+		m_imagesInFlight.assign(m_swapChainImages.size(), VK_NULL_HANDLE);
+		m_imageSubmissions.assign(m_swapChainImages.size(), 0);
+
+		double elapsedMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+		m_resizeStats.count++;
+		m_resizeStats.totalMs += elapsedMs;
+		m_resizeStats.maxMs = std::max(m_resizeStats.maxMs, elapsedMs);
+		m_resizeStats.hostAllocations += m_hostAllocator.counters().totalAllocations() - hostAllocationsBefore;
+	}
+
+	void printResizeStats()
+	{
+		if (m_resizeStats.count == 0) {
+			return;
+		}
+
+		std::cout << "swap chain recreation: " << m_resizeStats.count << " resizes, avg "
+			<< m_resizeStats.totalMs / m_resizeStats.count << " ms, max " << m_resizeStats.maxMs << " ms";
+		if (m_hostAllocator.callbacks()) {
+			std::cout << ", " << m_resizeStats.hostAllocations / m_resizeStats.count << " host allocations per resize";
+		}
+		std::cout << std::endl;
 	}
 
 	static void framebufferResizeCallback(GLFWwindow* window, int width, int height)
@@ -1006,16 +2583,620 @@ private:
 		app->m_framebufferResized = true;
 	}
 
+	void createGpuAllocator()
+	{
+		TRACE_SCOPE("createGpuAllocator");
+
+		m_gpuAllocator.create(m_vkLogicalDevice, m_vkPhysicalDevice, m_hostAllocator.callbacks());
+	}
+
+	//Random allocate/free mix with a bounded number of live allocations, first through the sub-allocator,
+	//then through one vkAllocateMemory per resource. The second run is kept well below maxMemoryAllocationCount.
+	void runAllocatorBenchmark()
+	{
+		const uint32_t OPERATIONS = 200000;
+		const uint32_t MAX_LIVE = 2000;
+		const uint32_t DIRECT_OPERATIONS = 10000;
+		const uint32_t DIRECT_MAX_LIVE = 500;
+		const VkDeviceSize MIN_SIZE = 256;
+
+		//Memory type bits and alignment of a typical buffer
+		VkBuffer probeBuffer;
+		GpuAllocation probeMemory;
+		createBuffer(MIN_SIZE, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, probeBuffer, probeMemory);
+		VkMemoryRequirements probeRequirements;
+		vkGetBufferMemoryRequirements(m_vkLogicalDevice, probeBuffer, &probeRequirements);
+		vkDestroyBuffer(m_vkLogicalDevice, probeBuffer, m_hostAllocator.callbacks());
+		m_gpuAllocator.free(probeMemory);
+
+		uint32_t memoryTypeIndex = m_gpuAllocator.findMemoryType(probeRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+		//Same pseudo random sequence for both runs, sizes between 256 B and 1 MB
+		auto runSequence = [&](uint32_t operations_, uint32_t maxLive_, const std::function<void(VkDeviceSize)>& allocate_, const std::function<void(size_t)>& free_, size_t& liveCount_) {
+			uint32_t state = 12345;
+			auto next = [&]() { state = state * 1664525u + 1013904223u; return state >> 8; };
+
+			auto start = std::chrono::high_resolution_clock::now();
+			for (uint32_t i = 0; i < operations_; i++) {
+				bool doAllocate = liveCount_ == 0 || (liveCount_ < maxLive_ && (next() & 1));
+				if (doAllocate) {
+					VkDeviceSize size = MIN_SIZE << (next() % 12);
+					allocate_(size + next() % size);
+					liveCount_++;
+				}
+				else {
+					free_(next() % liveCount_);
+					liveCount_--;
+				}
+			}
+			return std::chrono::duration<double, std::micro>(std::chrono::high_resolution_clock::now() - start).count();
+		};
+
+		//1. Sub-allocator
+		std::vector<GpuAllocation> allocations;
+		size_t liveCount = 0;
+		double allocatorUs = runSequence(OPERATIONS, MAX_LIVE,
+			[&](VkDeviceSize size_) {
+				VkMemoryRequirements requirements = probeRequirements;
+				requirements.size = size_;
+				allocations.emplace_back();
+				m_gpuAllocator.allocate(requirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, GpuAllocator::ResourceKind::Linear, allocations.back());
+			},
+			[&](size_t index_) {
+				m_gpuAllocator.free(allocations[index_]);
+				allocations[index_] = allocations.back();
+				allocations.pop_back();
+			}, liveCount);
+
+		std::cout << "allocator benchmark, state with up to " << MAX_LIVE << " live allocations:" << std::endl;
+		m_gpuAllocator.printStats();
+
+		for (GpuAllocation& allocation : allocations) {
+			m_gpuAllocator.free(allocation);
+		}
+
+		//2. One vkAllocateMemory per resource
+		std::vector<VkDeviceMemory> memories;
+		liveCount = 0;
+		double directUs = runSequence(DIRECT_OPERATIONS, DIRECT_MAX_LIVE,
+			[&](VkDeviceSize size_) {
+				VkMemoryAllocateInfo allocInfo = {};
+				allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+				allocInfo.allocationSize = size_;
+				allocInfo.memoryTypeIndex = memoryTypeIndex;
+
+				VkDeviceMemory memory;
+				if (vkAllocateMemory(m_vkLogicalDevice, &allocInfo, m_hostAllocator.callbacks(), &memory) != VK_SUCCESS) {
+					throw std::runtime_error("failed to allocate device memory! [::runAllocatorBenchmark]");
+				}
+				memories.push_back(memory);
+			},
+			[&](size_t index_) {
+				vkFreeMemory(m_vkLogicalDevice, memories[index_], m_hostAllocator.callbacks());
+				memories[index_] = memories.back();
+				memories.pop_back();
+			}, liveCount);
+
+		for (VkDeviceMemory memory : memories) {
+			vkFreeMemory(m_vkLogicalDevice, memory, m_hostAllocator.callbacks());
+		}
+
+		double allocatorRate = OPERATIONS / (allocatorUs / 1000000.0);
+		double directRate = DIRECT_OPERATIONS / (directUs / 1000000.0);
+		std::cout << "sub-allocator: " << allocatorRate << " ops/s, " << allocatorUs / OPERATIONS << " us per op" << std::endl;
+		std::cout << "vkAllocateMemory: " << directRate << " ops/s, " << directUs / DIRECT_OPERATIONS << " us per op" << std::endl;
+		std::cout << "speedup: " << (directRate > 0.0 ? allocatorRate / directRate : 0.0) << "x" << std::endl;
+	}
+
+	//////////////////////////////////////////////////////////////////////////////////////////////////////
+	//////////////////////////////  Functions to Support Vertex Buffers : createVertexBuffer()
+	void createTransferCommandPool()
+	{
+		TRACE_SCOPE("createTransferCommandPool");
+
+		const QueueFamilyIndices& queueFamilyIndices = m_deviceCapabilities.queueFamilyIndices;
+
+		//Only short lived upload command buffers come from this pool
+		VkCommandPoolCreateInfo poolInfo = {};
+		poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+		poolInfo.queueFamilyIndex = queueFamilyIndices.transferFamily.value();
+		poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+
+		if (vkCreateCommandPool(m_vkLogicalDevice, &poolInfo, m_hostAllocator.callbacks(), &m_transferCommandPool) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create transfer command pool! [::createTransferCommandPool]");
+		}
+	}
+
+	void createBuffer(VkDeviceSize size_, VkBufferUsageFlags usage_, VkMemoryPropertyFlags properties_, VkBuffer& buffer_, GpuAllocation& bufferMemory_)
+	{
+		VkBufferCreateInfo bufferInfo = {};
+		bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+		bufferInfo.size = size_;
+		bufferInfo.usage = usage_;
+
+		//Buffers used on more than one queue family change owner with release and acquire barriers
+		//(see queueDeviceLocalUpload()), which keeps the driver free to use its fastest layout
+		bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+		if (vkCreateBuffer(m_vkLogicalDevice, &bufferInfo, m_hostAllocator.callbacks(), &buffer_) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create buffer! [::createBuffer]");
+		}
+
+		m_gpuAllocator.allocateBufferMemory(buffer_, properties_, bufferMemory_);
+	}
+
+	//Allocates a primary command buffer from commandPool_ and begins it for a single submission
+	VkCommandBuffer beginOneTimeCommandBuffer(VkCommandPool commandPool_)
+	{
+		VkCommandBufferAllocateInfo allocInfo = {};
+		allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		allocInfo.commandPool = commandPool_;
+		allocInfo.commandBufferCount = 1;
+
+		VkCommandBuffer commandBuffer;
+		if (vkAllocateCommandBuffers(m_vkLogicalDevice, &allocInfo, &commandBuffer) != VK_SUCCESS) {
+			throw std::runtime_error("failed to allocate one time command buffer! [::beginOneTimeCommandBuffer]");
+		}
+
+		VkCommandBufferBeginInfo beginInfo = {};
+		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+		vkBeginCommandBuffer(commandBuffer, &beginInfo);
+		return commandBuffer;
+	}
+
+	//Whole buffer barrier between two queue families. Distinct families make it an ownership transfer, which is
+	//recorded twice with identical indices: as release on the source queue and as acquire on the destination queue.
+	VkBufferMemoryBarrier bufferOwnershipBarrier(VkBuffer buffer_, uint32_t srcFamily_, uint32_t dstFamily_, VkAccessFlags srcAccess_, VkAccessFlags dstAccess_)
+	{
+		VkBufferMemoryBarrier barrier = {};
+		barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+		barrier.srcAccessMask = srcAccess_;
+		barrier.dstAccessMask = dstAccess_;
+		barrier.srcQueueFamilyIndex = srcFamily_ != dstFamily_ ? srcFamily_ : VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = srcFamily_ != dstFamily_ ? dstFamily_ : VK_QUEUE_FAMILY_IGNORED;
+		barrier.buffer = buffer_;
+		barrier.offset = 0;
+		barrier.size = VK_WHOLE_SIZE;
+		return barrier;
+	}
+
+	//Records and submits one copy on the transfer queue and waits for it to finish.
+	//The destination stays owned by the transfer family, so this is only meant for benchmarks.
+	void copyBuffer(VkBuffer srcBuffer_, VkBuffer dstBuffer_, VkDeviceSize size_)
+	{
+		VkCommandBuffer commandBuffer = beginOneTimeCommandBuffer(m_transferCommandPool);
+
+		VkBufferCopy copyRegion = {};
+		copyRegion.srcOffset = 0;
+		copyRegion.dstOffset = 0;
+		copyRegion.size = size_;
+		vkCmdCopyBuffer(commandBuffer, srcBuffer_, dstBuffer_, 1, &copyRegion);
+
+		vkEndCommandBuffer(commandBuffer);
+
+		VkFenceCreateInfo fenceInfo = {};
+		fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+
+		VkFence fence;
+		if (vkCreateFence(m_vkLogicalDevice, &fenceInfo, m_hostAllocator.callbacks(), &fence) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create transfer fence! [::copyBuffer]");
+		}
+
+		VkSubmitInfo submitInfo = {};
+		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &commandBuffer;
+
+		if (vkQueueSubmit(m_transferQueue, 1, &submitInfo, fence) != VK_SUCCESS) {
+			throw std::runtime_error("failed to submit transfer command buffer! [::copyBuffer]");
+		}
+		vkWaitForFences(m_vkLogicalDevice, 1, &fence, VK_TRUE, UINT64_MAX);
+
+		vkDestroyFence(m_vkLogicalDevice, fence, m_hostAllocator.callbacks());
+		vkFreeCommandBuffers(m_vkLogicalDevice, m_transferCommandPool, 1, &commandBuffer);
+	}
+
+	//Stages data_ and records its copy into a new device local buffer. Nothing is submitted until
+	//submitUploads(), so every upload during init shares one transfer submission.
+	//dstAccess_ is how the graphics queue reads the buffer afterwards, it is vertex input in every case so far.
+	void queueDeviceLocalUpload(const void* data_, VkDeviceSize size_, VkBufferUsageFlags usage_, VkAccessFlags dstAccess_, VkBuffer& buffer_, GpuAllocation& bufferMemory_)
+	{
+		if (m_pendingUploads.submitted) {
+			throw std::runtime_error("uploads were already submitted [::queueDeviceLocalUpload]");
+		}
+
+		//1. Host visible allocations are persistently mapped by the allocator
+		VkBuffer stagingBuffer;
+		GpuAllocation stagingBufferMemory;
+		createBuffer(size_, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
+		memcpy(stagingBufferMemory.mapped, data_, static_cast<size_t>(size_));
+		m_pendingUploads.stagingBuffers.push_back({ stagingBuffer, stagingBufferMemory });
+
+		createBuffer(size_, VK_BUFFER_USAGE_TRANSFER_DST_BIT | usage_, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, buffer_, bufferMemory_);
+
+		//2. Copy on the transfer queue
+		if (m_pendingUploads.transferCommandBuffer == VK_NULL_HANDLE) {
+			m_pendingUploads.transferCommandBuffer = beginOneTimeCommandBuffer(m_transferCommandPool);
+		}
+		VkCommandBuffer commandBuffer = m_pendingUploads.transferCommandBuffer;
+
+		VkBufferCopy copyRegion = {};
+		copyRegion.size = size_;
+		vkCmdCopyBuffer(commandBuffer, stagingBuffer, buffer_, 1, &copyRegion);
+
+		//3. Between distinct families the release only makes the write available, the acquire recorded by
+		//submitUploads() on the graphics queue makes it visible to dstAccess_. Within one family a plain barrier does both.
+		const QueueFamilyIndices& indices = m_deviceCapabilities.queueFamilyIndices;
+		uint32_t transferFamily = indices.transferFamily.value();
+		uint32_t graphicsFamily = indices.graphicsFamily.value();
+		bool ownershipTransfer = transferFamily != graphicsFamily;
+
+		VkBufferMemoryBarrier release = bufferOwnershipBarrier(buffer_, transferFamily, graphicsFamily,
+			VK_ACCESS_TRANSFER_WRITE_BIT, ownershipTransfer ? 0 : dstAccess_);
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+			ownershipTransfer ? VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT : VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+			0, 0, nullptr, 1, &release, 0, nullptr);
+
+		if (ownershipTransfer) {
+			m_pendingUploads.acquireBarriers.push_back(bufferOwnershipBarrier(buffer_, transferFamily, graphicsFamily, 0, dstAccess_));
+		}
+		m_pendingUploads.bytes += size_;
+	}
+
+	//Submits the recorded uploads on the transfer queue without waiting for them. The hand-off to the
+	//graphics queue is a semaphore the next frame waits on, see drawFrame(), so the copies overlap
+	//whatever the CPU and the graphics queue do until then.
+	void submitUploads()
+	{
+		TRACE_SCOPE("submitUploads");
+
+		if (m_pendingUploads.transferCommandBuffer == VK_NULL_HANDLE) {
+			return;
+		}
+		vkEndCommandBuffer(m_pendingUploads.transferCommandBuffer);
+
+		//1. Signalled by the transfer submission, waited on by the first frame
+		VkSemaphoreCreateInfo semaphoreInfo = {};
+		semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+		if (vkCreateSemaphore(m_vkLogicalDevice, &semaphoreInfo, m_hostAllocator.callbacks(), &m_pendingUploads.semaphore) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create upload semaphore! [::submitUploads]");
+		}
+
+		VkSubmitInfo submitInfo = {};
+		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &m_pendingUploads.transferCommandBuffer;
+		submitInfo.signalSemaphoreCount = 1;
+		submitInfo.pSignalSemaphores = &m_pendingUploads.semaphore;
+
+		if (vkQueueSubmit(m_transferQueue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
+			throw std::runtime_error("failed to submit upload command buffer! [::submitUploads]");
+		}
+
+		//2. The acquire half of the ownership transfers runs on the graphics queue ahead of the first frame.
+		//The frame waits on the semaphore at VERTEX_INPUT, so only that stage is ordered after the transfer queue's release.
+		//The barrier's source stage is that wait stage, which chains it behind the semaphore wait.
+		if (!m_pendingUploads.acquireBarriers.empty()) {
+			m_pendingUploads.acquireCommandBuffer = beginOneTimeCommandBuffer(m_commandPool);
+			vkCmdPipelineBarrier(m_pendingUploads.acquireCommandBuffer, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, 0,
+				0, nullptr, static_cast<uint32_t>(m_pendingUploads.acquireBarriers.size()), m_pendingUploads.acquireBarriers.data(), 0, nullptr);
+			vkEndCommandBuffer(m_pendingUploads.acquireCommandBuffer);
+		}
+		m_pendingUploads.submitted = true;
+
+		std::cout << "uploads: " << m_pendingUploads.stagingBuffers.size() << " buffers, " << m_pendingUploads.bytes / 1024.0 << " KB"
+			<< (m_pendingUploads.acquireBarriers.empty() ? " on the graphics family" : " on the dedicated transfer family") << std::endl;
+	}
+
+	//Called right after the frame waiting on the uploads was submitted, their resources go once that frame completes
+	void retireUploads()
+	{
+		VkDevice device = m_vkLogicalDevice;
+		const VkAllocationCallbacks* allocator = m_hostAllocator.callbacks();
+		GpuAllocator* gpuAllocator = &m_gpuAllocator;
+		VkCommandPool transferCommandPool = m_transferCommandPool;
+		VkCommandPool graphicsCommandPool = m_commandPool;
+		PendingUploads uploads = std::move(m_pendingUploads);
+		m_pendingUploads = PendingUploads();
+
+		deferDestruction([=]() mutable {
+			for (auto& staging : uploads.stagingBuffers) {
+				vkDestroyBuffer(device, staging.first, allocator);
+				gpuAllocator->free(staging.second);
+			}
+			vkFreeCommandBuffers(device, transferCommandPool, 1, &uploads.transferCommandBuffer);
+			if (uploads.acquireCommandBuffer != VK_NULL_HANDLE) {
+				vkFreeCommandBuffers(device, graphicsCommandPool, 1, &uploads.acquireCommandBuffer);
+			}
+			vkDestroySemaphore(device, uploads.semaphore, allocator);
+		});
+	}
+
+	//////////////////////////////////////////////////////////////////////////////////////////////////////
+	//////////////////////////////  Functions to Support Uniform Buffers : createUniformRing()
+	void createDescriptorAllocator()
+	{
+		TRACE_SCOPE("createDescriptorAllocator");
+
+		//A slot per frame in flight, reset once its fence signals, plus a long lived one for sets used by the static
+		//command buffers
+		m_descriptorAllocator.create(m_vkLogicalDevice, m_framesInFlight + 1, m_hostAllocator.callbacks());
+	}
+
+	void createBindlessTable()
+	{
+		TRACE_SCOPE("createBindlessTable");
+
+		if (!m_bindlessEnabled) {
+			return;
+		}
+
+		m_bindlessTable.create(m_vkLogicalDevice, m_deviceCapabilities.bindlessStorageBuffers, m_deviceCapabilities.bindlessSampledImages,
+			m_hostAllocator.callbacks());
+	}
+
+	//Per draw data, the dynamic offset picks the draw's slice of the uniform ring
+	static std::vector<VkDescriptorSetLayoutBinding> drawUniformBindings()
+	{
+		VkDescriptorSetLayoutBinding uniformBinding = {};
+		uniformBinding.binding = 0;
+		uniformBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+		uniformBinding.descriptorCount = 1;
+		uniformBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+		return { uniformBinding };
+	}
+
+	void createUniformRing()
+	{
+		TRACE_SCOPE("createUniformRing");
+
+		//1. One region per frame in flight plus one shared by the static command buffers, each large enough for every draw.
+		//Instanced draws read the instance stream instead, a single draw's region is enough for them.
+		VkDeviceSize alignment = m_deviceCapabilities.properties.limits.minUniformBufferOffsetAlignment;
+		VkDeviceSize drawStride = (sizeof(DrawUniforms) + alignment - 1) / alignment * alignment;
+		uint32_t ringDraws = m_options.instanced ? 1 : std::max(1u, m_options.drawCount);
+		m_uniformRing.create(m_vkLogicalDevice, &m_gpuAllocator, alignment, m_framesInFlight + 1,
+			ringDraws * drawStride, m_bindlessEnabled ? VK_BUFFER_USAGE_STORAGE_BUFFER_BIT : 0,
+			m_hostAllocator.callbacks());
+
+		//2. Bindless shaders read the whole ring as an array of DrawUniforms
+		if (m_bindlessEnabled) {
+			m_drawBufferIndex = m_bindlessTable.addStorageBuffer(m_uniformRing.buffer(), 0, VK_WHOLE_SIZE);
+			return;
+		}
+
+		//3. A single set for the lifetime of the ring, draws only change its dynamic offset
+		m_uniformDescriptorSet = allocateUniformDescriptorSet(m_framesInFlight, m_uniformRing.buffer(), 0);
+	}
+
+	//A set whose binding 0 views sizeof(DrawUniforms) bytes of buffer_ starting at offset_ (plus the dynamic offset)
+	VkDescriptorSet allocateUniformDescriptorSet(uint32_t allocatorSlot_, VkBuffer buffer_, VkDeviceSize offset_)
+	{
+		VkDescriptorSet descriptorSet = m_descriptorAllocator.allocate(allocatorSlot_, m_descriptorSetLayout);
+
+		VkDescriptorBufferInfo bufferInfo = {};
+		bufferInfo.buffer = buffer_;
+		bufferInfo.offset = offset_;
+		bufferInfo.range = sizeof(DrawUniforms);
+
+		VkWriteDescriptorSet descriptorWrite = {};
+		descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		descriptorWrite.dstSet = descriptorSet;
+		descriptorWrite.dstBinding = 0;
+		descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+		descriptorWrite.descriptorCount = 1;
+		descriptorWrite.pBufferInfo = &bufferInfo;
+		vkUpdateDescriptorSets(m_vkLogicalDevice, 1, &descriptorWrite, 0, nullptr);
+
+		return descriptorSet;
+	}
+
+	//Draws are laid out on a square grid over the viewport, a single draw covers it like the plain quad did
+	static DrawUniforms drawUniforms(uint32_t drawIndex_, uint32_t columns_)
+	{
+		float cell = 2.0f / columns_;
+		DrawUniforms uniforms;
+		uniforms.transform = glm::mat4(1.0f);
+		uniforms.transform[0][0] = cell * 0.5f;
+		uniforms.transform[1][1] = cell * 0.5f;
+		uniforms.transform[3][0] = -1.0f + cell * (drawIndex_ % columns_ + 0.5f);
+		uniforms.transform[3][1] = -1.0f + cell * (drawIndex_ / columns_ + 0.5f);
+		return uniforms;
+	}
+
+	static uint32_t gridColumns(uint32_t drawCount_)
+	{
+		return std::max(1u, static_cast<uint32_t>(std::ceil(std::sqrt(double(drawCount_)))));
+	}
+
+	//Records drawCount_ draws into a render pass and returns the CPU time in ms. With a ring every draw is a push and a
+	//dynamic offset, otherwise every draw allocates and writes its own descriptor set pointing at its slice of the ring.
+	double recordUniformBenchmarkDraws(VkCommandBuffer commandBuffer_, UniformRing& ring_, uint32_t allocatorSlot_, uint32_t drawCount_, bool useRing_)
+	{
+		VkRenderPassBeginInfo renderPassInfo = {};
+		renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+		renderPassInfo.renderPass = m_renderPass;
+		renderPassInfo.framebuffer = m_swapChainFramebuffers[0];
+		renderPassInfo.renderArea.extent = m_swapChainExtent;
+		VkClearValue clearColor = { 0.f, 0.f, 0.f, 1.f };
+		renderPassInfo.clearValueCount = 1;
+		renderPassInfo.pClearValues = &clearColor;
+
+		VkDescriptorSet ringSet = useRing_ ? allocateUniformDescriptorSet(allocatorSlot_, ring_.buffer(), 0) : VK_NULL_HANDLE;
+		uint32_t columns = gridColumns(drawCount_);
+		ring_.beginFrame(0);
+
+		auto start = std::chrono::high_resolution_clock::now();
+		vkCmdBeginRenderPass(commandBuffer_, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+		vkCmdBindPipeline(commandBuffer_, VK_PIPELINE_BIND_POINT_GRAPHICS, m_graphicsPipeline);
+		VkDeviceSize vertexOffset = 0;
+		vkCmdBindVertexBuffers(commandBuffer_, 0, 1, &m_vertexBuffer, &vertexOffset);
+		vkCmdBindIndexBuffer(commandBuffer_, m_indexBuffer, 0, VK_INDEX_TYPE_UINT16);
+
+		for (uint32_t i = 0; i < drawCount_; i++) {
+			uint32_t dynamicOffset = ring_.push(drawUniforms(i, columns));
+			VkDescriptorSet descriptorSet = ringSet;
+			if (!useRing_) {
+				descriptorSet = allocateUniformDescriptorSet(allocatorSlot_, ring_.buffer(), dynamicOffset);
+				dynamicOffset = 0;
+			}
+			vkCmdBindDescriptorSets(commandBuffer_, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipelineLayout, 0, 1, &descriptorSet, 1, &dynamicOffset);
+			vkCmdDrawIndexed(commandBuffer_, static_cast<uint32_t>(quadIndices.size()), 1, 0, 0, 0);
+		}
+		vkCmdEndRenderPass(commandBuffer_);
+		return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	}
+
+	//Recording only, nothing is submitted, so the numbers are the CPU side of feeding per draw data
+	void runUniformBenchmark()
+	{
+		const uint32_t ITERATIONS = 5;
+		const uint32_t drawCounts[] = { 10000, 100000 };
+
+		if (m_pendingPipeline.valid()) {
+			finishPendingPipeline();
+		}
+		if (m_graphicsPipeline == VK_NULL_HANDLE) {
+			throw std::runtime_error("no graphics pipeline to record with [::runUniformBenchmark]");
+		}
+		if (m_bindlessEnabled) {
+			std::cout << "uniform benchmark needs the dynamic uniform buffer pipeline layout, run it without --bindless" << std::endl;
+			return;
+		}
+		if (m_options.instanced) {
+			std::cout << "uniform benchmark records one draw per uniform region, run it without --instanced" << std::endl;
+			return;
+		}
+
+		std::cout << "uniform benchmark: " << ITERATIONS << " recordings per draw count" << std::endl;
+		std::cout << "draws	ring ns/draw	descriptor set ns/draw	speedup" << std::endl;
+
+		for (uint32_t drawCount : drawCounts) {
+			VkDeviceSize alignment = m_uniformRing.alignment();
+			UniformRing ring;
+			ring.create(m_vkLogicalDevice, &m_gpuAllocator, alignment, 1,
+				drawCount * ((sizeof(DrawUniforms) + alignment - 1) / alignment * alignment), 0, m_hostAllocator.callbacks());
+
+			double ringMs = 0.0;
+			double setMs = 0.0;
+			for (uint32_t i = 0; i < ITERATIONS; i++) {
+				for (bool useRing : { true, false }) {
+					VkCommandBuffer commandBuffer = beginOneTimeCommandBuffer(m_commandPool);
+					double elapsedMs = recordUniformBenchmarkDraws(commandBuffer, ring, 0, drawCount, useRing);
+					vkEndCommandBuffer(commandBuffer);
+					vkFreeCommandBuffers(m_vkLogicalDevice, m_commandPool, 1, &commandBuffer);
+
+					//No frame has been submitted yet, so the first frame's slot is free to reuse between recordings
+					m_descriptorAllocator.resetSlot(0);
+
+					(useRing ? ringMs : setMs) += elapsedMs;
+				}
+			}
+
+			ring.destroy();
+
+			double ringNs = ringMs * 1000000.0 / (double(drawCount) * ITERATIONS);
+			double setNs = setMs * 1000000.0 / (double(drawCount) * ITERATIONS);
+			std::cout << drawCount << "\t" << ringNs << "\t" << setNs << "\t" << (ringNs > 0.0 ? setNs / ringNs : 0.0) << "x" << std::endl;
+		}
+	}
+
+	void createVertexBuffer()
+	{
+		TRACE_SCOPE("createVertexBuffer");
+
+		queueDeviceLocalUpload(quadVertices.data(), sizeof(quadVertices[0]) * quadVertices.size(),
+			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT, m_vertexBuffer, m_vertexBufferMemory);
+	}
+
+	void createIndexBuffer()
+	{
+		TRACE_SCOPE("createIndexBuffer");
+
+		queueDeviceLocalUpload(quadIndices.data(), sizeof(quadIndices[0]) * quadIndices.size(),
+			VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_ACCESS_INDEX_READ_BIT, m_indexBuffer, m_indexBufferMemory);
+	}
+
+	//Same grid as drawUniforms(), one element per draw
+	void createInstanceBuffer()
+	{
+		TRACE_SCOPE("createInstanceBuffer");
+
+		if (!m_options.instanced) {
+			return;
+		}
+
+		uint32_t instanceCount = std::max(1u, m_options.drawCount);
+		uint32_t columns = gridColumns(instanceCount);
+		std::vector<InstanceData> instances(instanceCount);
+		for (uint32_t i = 0; i < instanceCount; i++) {
+			glm::mat4 transform = drawUniforms(i, columns).transform;
+			instances[i].transform = glm::vec4(transform[0][0], transform[1][1], transform[3][0], transform[3][1]);
+			instances[i].color = glm::vec3(float(i % columns) / columns, float(i / columns) / columns, 1.0f);
+		}
+
+		queueDeviceLocalUpload(instances.data(), sizeof(instances[0]) * instances.size(),
+			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT, m_instanceBuffer, m_instanceBufferMemory);
+	}
+
+	//Host copy into a persistently mapped staging buffer plus the transfer queue copy, for a range of upload sizes
+	void runUploadBenchmark()
+	{
+		const uint32_t ITERATIONS = 20;
+		const VkDeviceSize sizes[] = { 64 * 1024, 1024 * 1024, 16 * 1024 * 1024, 64 * 1024 * 1024 };
+
+		std::cout << "upload benchmark: " << ITERATIONS << " uploads per size" << std::endl;
+		std::cout << "size KB	host copy MB/s	transfer MB/s	total MB/s" << std::endl;
+
+		for (VkDeviceSize size : sizes) {
+			std::vector<char> source(static_cast<size_t>(size), 1);
+
+			VkBuffer stagingBuffer, deviceBuffer;
+			GpuAllocation stagingBufferMemory, deviceBufferMemory;
+			createBuffer(size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
+			createBuffer(size, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, deviceBuffer, deviceBufferMemory);
+
+
+			double hostMs = 0.0;
+			double transferMs = 0.0;
+			for (uint32_t i = 0; i < ITERATIONS; i++) {
+				auto start = std::chrono::high_resolution_clock::now();
+				memcpy(stagingBufferMemory.mapped, source.data(), source.size());
+				auto copied = std::chrono::high_resolution_clock::now();
+				copyBuffer(stagingBuffer, deviceBuffer, size);
+				auto end = std::chrono::high_resolution_clock::now();
+
+				hostMs += std::chrono::duration<double, std::milli>(copied - start).count();
+				transferMs += std::chrono::duration<double, std::milli>(end - copied).count();
+			}
+
+			vkDestroyBuffer(m_vkLogicalDevice, stagingBuffer, m_hostAllocator.callbacks());
+			m_gpuAllocator.free(stagingBufferMemory);
+			vkDestroyBuffer(m_vkLogicalDevice, deviceBuffer, m_hostAllocator.callbacks());
+			m_gpuAllocator.free(deviceBufferMemory);
+
+			double megabytes = double(size) * ITERATIONS / (1024.0 * 1024.0);
+			std::cout << size / 1024 << "\t" << megabytes / (hostMs / 1000.0) << "\t" << megabytes / (transferMs / 1000.0)
+				<< "\t" << megabytes / ((hostMs + transferMs) / 1000.0) << std::endl;
+		}
+	}
+
 	//////////////////////////////////////////////////////////////////////////////////////////////////////
 	//////////////////////////////  Functions to Support Pipeline creation : createGraphicsPipeline()
-	VkShaderModule createShaderModule(const std::vector<char>& code) {
+	VkShaderModule createShaderModule(const ShaderCompiler::Spirv& code) {
+		//Usually points straight into the mapped cache file, which is word aligned
 		VkShaderModuleCreateInfo createInfo = {};
 		createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
 		createInfo.codeSize = code.size();
-		createInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());
+		createInfo.pCode = code.code();
 
 		VkShaderModule shaderModule;
-		if (vkCreateShaderModule(m_vkLogicalDevice, &createInfo, nullptr, &shaderModule) != VK_SUCCESS)
+		if (vkCreateShaderModule(m_vkLogicalDevice, &createInfo, m_hostAllocator.callbacks(), &shaderModule) != VK_SUCCESS)
 		{
 			throw std::runtime_error("failed to create shader module!");
 		}
@@ -1025,15 +3206,197 @@ private:
 
 	//////////////////////////////////////////////////////////////////////////////////////////////////////
 	//////////////////////////////  Functions to Support Drawing and Presentation : mainLoop()
+	void recordFrameCommandBuffer(uint32_t imageIndex_)
+	{
+		TRACE_SCOPE("recordFrameCommandBuffer");
+
+		auto start = std::chrono::high_resolution_clock::now();
+
+		//The slot's fence has signalled, so every command buffer allocated from its pool is free to reuse
+		vkResetCommandPool(m_vkLogicalDevice, m_frameCommandPools[m_currentFrame], 0);
+		m_uniformRing.beginFrame(m_currentFrame);
+		if (m_threadPool) {
+			for (uint32_t i = 0; i < m_threadPool->threadCount(); i++) {
+				WorkerCommandPool& workerPool = m_workerCommandPools[m_currentFrame * m_threadPool->threadCount() + i];
+				vkResetCommandPool(m_vkLogicalDevice, workerPool.commandPool, 0);
+				workerPool.usedCount = 0;
+			}
+		}
+		if (m_graphicsPipeline == VK_NULL_HANDLE) {
+			m_framesWithoutPipeline++;
+		}
+		recordCommandBuffer(m_frameCommandBuffers[m_currentFrame], imageIndex_, VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+
+		double elapsedMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+		m_recordStats.count++;
+		m_recordStats.lastMs = elapsedMs;
+		m_recordStats.totalMs += elapsedMs;
+		m_recordStats.maxMs = std::max(m_recordStats.maxMs, elapsedMs);
+	}
+
+	//Records the same draw list with 0 (inline), 1, 2, 4 ... hardware_concurrency workers and reports CPU frame times
+	void runThreadScalingBenchmark()
+	{
+		const uint32_t BENCHMARK_FRAMES = 200;
+
+		std::vector<uint32_t> threadCounts = { 0 };
+		uint32_t maxThreads = std::max(1u, std::thread::hardware_concurrency());
+		for (uint32_t threads = 1; threads < maxThreads; threads *= 2) {
+			threadCounts.push_back(threads);
+		}
+		threadCounts.push_back(maxThreads);
+
+		std::cout << "thread scaling benchmark: " << m_options.drawCount << " draws, " << BENCHMARK_FRAMES << " frames per run" << std::endl;
+		std::cout << "threads\trecord avg ms\tframe avg ms\trecord speedup" << std::endl;
+
+		double baselineRecordMs = 0.0;
+		for (uint32_t threads : threadCounts) {
+			vkDeviceWaitIdle(m_vkLogicalDevice);
+			destroyWorkerCommandPools();
+			createWorkerCommandPools(threads);
+			m_recordStats = RecordStats();
+
+			auto start = std::chrono::high_resolution_clock::now();
+			for (uint32_t frame = 0; frame < BENCHMARK_FRAMES && (m_options.headless || !glfwWindowShouldClose(m_window)); frame++) {
+				if (!m_options.headless) {
+					glfwPollEvents();
+				}
+				drawFrame();
+			}
+			double frameMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count() / BENCHMARK_FRAMES;
+
+			double recordMs = m_recordStats.count > 0 ? m_recordStats.totalMs / m_recordStats.count : 0.0;
+			if (threads == 0) {
+				baselineRecordMs = recordMs;
+			}
+
+			std::cout << threads << "\t" << recordMs << "\t" << frameMs << "\t"
+				<< (recordMs > 0.0 ? baselineRecordMs / recordMs : 0.0) << "x" << std::endl;
+		}
+
+		vkDeviceWaitIdle(m_vkLogicalDevice);
+	}
+
+	//Same instances, same pipeline and same instance stream, only the number of draw calls changes
+	void runInstancingBenchmark()
+	{
+		const uint32_t BENCHMARK_FRAMES = 100;
+
+		//Triangles, the first half of the quad
+		m_instanceIndexCount = 3;
+
+		std::cout << "instancing benchmark: " << m_options.drawCount << " triangle instances, " << BENCHMARK_FRAMES << " frames per run" << std::endl;
+		std::cout << "path\tdraw calls per frame\trecord avg ms\tframe avg ms" << std::endl;
+
+		for (bool perInstance : { false, true }) {
+			vkDeviceWaitIdle(m_vkLogicalDevice);
+			m_drawPerInstance = perInstance;
+			m_recordStats = RecordStats();
+			uint64_t drawCallsBefore = m_drawCallCount.load();
+
+			auto start = std::chrono::high_resolution_clock::now();
+			for (uint32_t frame = 0; frame < BENCHMARK_FRAMES; frame++) {
+				drawFrame();
+			}
+			vkDeviceWaitIdle(m_vkLogicalDevice);
+			double frameMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count() / BENCHMARK_FRAMES;
+
+			double recordMs = m_recordStats.count > 0 ? m_recordStats.totalMs / m_recordStats.count : 0.0;
+			std::cout << (perInstance ? "draw per object" : "instanced") << "\t" << (m_drawCallCount.load() - drawCallsBefore) / BENCHMARK_FRAMES
+				<< "\t" << recordMs << "\t" << frameMs << std::endl;
+		}
+
+		m_drawPerInstance = false;
+		m_instanceIndexCount = static_cast<uint32_t>(quadIndices.size());
+	}
+
+	void printRecordStats()
+	{
+		if (m_recordStats.count == 0) {
+			return;
+		}
+
+		std::cout << "command recording: " << m_recordStats.count << " frames, avg "
+			<< m_recordStats.totalMs / m_recordStats.count << " ms, max " << m_recordStats.maxMs << " ms" << std::endl;
+	}
+
+	//Blocks until the last frame recorded into the current slot has finished on the GPU
+	void waitForFrameSlot()
+	{
+		TRACE_SCOPE("waitForFrameSlot");
+
+		if (m_timelineSemaphoresEnabled) {
+			waitForTimelineValue(m_frameSubmissions[m_currentFrame]);
+			return;
+		}
+
+		vkWaitForFences(m_vkLogicalDevice, 1, &m_inFLightFences[m_currentFrame], VK_TRUE, UINT64_MAX);
+
+		//Submissions retire in order on the graphics queue, so everything up to this slot's last frame is done
+		m_completedFrames = std::max(m_completedFrames, m_frameSubmissions[m_currentFrame]);
+	}
+
+	//An image can come back from the swap chain while an older frame in another slot still renders to it
+	void waitForImage(uint32_t imageIndex_)
+	{
+		TRACE_SCOPE("waitForImage");
+
+		if (m_timelineSemaphoresEnabled) {
+			//Usually already satisfied by the slot wait, in which case this does not call into the driver
+			waitForTimelineValue(m_imageSubmissions[imageIndex_]);
+			return;
+		}
+
+		if (m_imagesInFlight[imageIndex_] != VK_NULL_HANDLE) {
+			vkWaitForFences(m_vkLogicalDevice, 1, &m_imagesInFlight[imageIndex_], VK_TRUE, UINT64_MAX);
+
+			//The fence belongs to the image's last submission or a later one in the same slot, either way that submission is done
+			m_completedFrames = std::max(m_completedFrames, m_imageSubmissions[imageIndex_]);
+		}
+	}
+
+	void waitForTimelineValue(uint64_t value_)
+	{
+		if (value_ <= m_completedFrames) {
+			return;
+		}
+
+		VkSemaphoreWaitInfoKHR waitInfo = {};
+		waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO_KHR;
+		waitInfo.semaphoreCount = 1;
+		waitInfo.pSemaphores = &m_frameTimeline;
+		waitInfo.pValues = &value_;
+
+		if (m_pfnWaitSemaphores(m_vkLogicalDevice, &waitInfo, UINT64_MAX) != VK_SUCCESS) {
+			throw std::runtime_error("failed to wait for timeline semaphore!");
+		}
+
+		//The counter may already be past the value we waited for, which frees more deferred destructions
+		uint64_t counterValue = value_;
+		m_pfnGetSemaphoreCounterValue(m_vkLogicalDevice, m_frameTimeline, &counterValue);
+		m_completedFrames = std::max(m_completedFrames, counterValue);
+	}
+
 	void drawFrame()
 	{
 		//0. Wait for previous frame
-		vkWaitForFences(m_vkLogicalDevice, 1, &m_inFLightFences[m_currentFrame], VK_TRUE, UINT64_MAX);		
+		waitForFrameSlot();
+		flushDeferredDestructions(m_completedFrames);
+		m_descriptorAllocator.resetSlot(m_currentFrame);
+		updatePendingPipeline();
+		updateShaderHotReload();
 
-		//1. Retrieve an image from the Swap Chain
+		//1. Retrieve an image from the Swap Chain, or the next one of the offscreen ring
 		uint32_t imageIndex;
-		
-		VkResult result = vkAcquireNextImageKHR(m_vkLogicalDevice, m_swapChain, UINT64_MAX, m_imageAvailableSemaphores[m_currentFrame], VK_NULL_HANDLE, &imageIndex);
+		VkResult result = VK_SUCCESS;
+
+		if (m_options.headless) {
+			imageIndex = static_cast<uint32_t>(m_submittedFrames % m_swapChainImages.size());
+		}
+		else {
+			TRACE_SCOPE("vkAcquireNextImageKHR");
+			result = vkAcquireNextImageKHR(m_vkLogicalDevice, m_swapChain, UINT64_MAX, m_imageAvailableSemaphores[m_currentFrame], VK_NULL_HANDLE, &imageIndex);
+		}
 		
 		if (result == VK_ERROR_OUT_OF_DATE_KHR) {
 			recreateSwapChain();
@@ -1042,46 +3405,114 @@ private:
 		else if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) {
 			throw std::runtime_error("failed to acquire swap chain image!");
 		}
-		if (m_imagesInFlight[imageIndex] != VK_NULL_HANDLE) {
-			vkWaitForFences(m_vkLogicalDevice, 1, &m_imagesInFlight[imageIndex], VK_TRUE, UINT64_MAX);
-		}
+		waitForImage(imageIndex);
+
+		//The last submission using this query slot has finished, read its timestamps before they are reset
+		m_gpuProfiler.collect(profilerSlot(imageIndex));
 
-		m_imagesInFlight[imageIndex] = m_inFLightFences[m_currentFrame];
+		if (m_options.recordPerFrame) {
+			recordFrameCommandBuffer(imageIndex);
+		}
 
 		//2. Submit to the graphics Queue for rendering
 		VkSubmitInfo submitInfo = {};
 		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
 
-		VkSemaphore waitSemaphores[] = { m_imageAvailableSemaphores[m_currentFrame] };
-		VkPipelineStageFlags waitStages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
-		submitInfo.waitSemaphoreCount = 1;
-		submitInfo.pWaitSemaphores = waitSemaphores;
-		submitInfo.pWaitDstStageMask = waitStages;
-		submitInfo.commandBufferCount = 1;
-		submitInfo.pCommandBuffers = &m_commandBuffers[imageIndex];
-		VkSemaphore signalSemaphores[] = { m_renderFinishedSemaphores[m_currentFrame] };
-		submitInfo.signalSemaphoreCount = 1;
-		submitInfo.pSignalSemaphores = signalSemaphores;
+		//Offscreen frames neither wait for an acquire nor signal a present
+		std::vector<VkSemaphore> waitSemaphores;
+		std::vector<VkPipelineStageFlags> waitStages;
+		if (!m_options.headless) {
+			waitSemaphores.push_back(m_imageAvailableSemaphores[m_currentFrame]);
+			waitStages.push_back(VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT);
+		}
 
-		vkResetFences(m_vkLogicalDevice, 1, &m_inFLightFences[m_currentFrame]);
+		//The first frame after submitUploads() waits for the transfer queue and acquires the uploaded buffers
+		std::vector<VkCommandBuffer> commandBuffers;
+		bool consumesUploads = m_pendingUploads.submitted;
+		if (consumesUploads) {
+			waitSemaphores.push_back(m_pendingUploads.semaphore);
+			waitStages.push_back(VK_PIPELINE_STAGE_VERTEX_INPUT_BIT);
+			if (m_pendingUploads.acquireCommandBuffer != VK_NULL_HANDLE) {
+				commandBuffers.push_back(m_pendingUploads.acquireCommandBuffer);
+			}
+		}
+		commandBuffers.push_back(m_options.recordPerFrame ? m_frameCommandBuffers[m_currentFrame] : m_commandBuffers[imageIndex]);
+
+		submitInfo.waitSemaphoreCount = static_cast<uint32_t>(waitSemaphores.size());
+		submitInfo.pWaitSemaphores = waitSemaphores.data();
+		submitInfo.pWaitDstStageMask = waitStages.data();
+		submitInfo.commandBufferCount = static_cast<uint32_t>(commandBuffers.size());
+		submitInfo.pCommandBuffers = commandBuffers.data();
+
+		//Binary semaphores ignore their entry in the value arrays
+		std::vector<VkSemaphore> signalSemaphores;
+		std::vector<uint64_t> signalValues;
+		if (!m_options.headless) {
+			signalSemaphores.push_back(m_renderFinishedSemaphores[m_currentFrame]);
+			signalValues.push_back(0);
+		}
+		if (m_timelineSemaphoresEnabled) {
+			signalSemaphores.push_back(m_frameTimeline);
+			signalValues.push_back(m_submittedFrames + 1);
+		}
+		submitInfo.signalSemaphoreCount = static_cast<uint32_t>(signalSemaphores.size());
+		submitInfo.pSignalSemaphores = signalSemaphores.data();
+
+		std::vector<uint64_t> waitValues(waitSemaphores.size(), 0);
+
+		VkTimelineSemaphoreSubmitInfoKHR timelineSubmitInfo = {};
+		timelineSubmitInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO_KHR;
+		timelineSubmitInfo.waitSemaphoreValueCount = submitInfo.waitSemaphoreCount;
+		timelineSubmitInfo.pWaitSemaphoreValues = waitValues.data();
+		timelineSubmitInfo.signalSemaphoreValueCount = static_cast<uint32_t>(signalValues.size());
+		timelineSubmitInfo.pSignalSemaphoreValues = signalValues.data();
+
+		VkFence submitFence = VK_NULL_HANDLE;
+		if (m_timelineSemaphoresEnabled) {
+			submitInfo.pNext = &timelineSubmitInfo;
+		}
+		else {
+			submitFence = m_inFLightFences[m_currentFrame];
+			vkResetFences(m_vkLogicalDevice, 1, &submitFence);
+			m_imagesInFlight[imageIndex] = submitFence;
+		}
 
-		if (vkQueueSubmit(m_graphicsQueue, 1, &submitInfo, m_inFLightFences[m_currentFrame]) != VK_SUCCESS)
 		{
-			throw std::runtime_error("fialed to submit draw command buffer!");
+			TRACE_SCOPE("vkQueueSubmit");
+			if (vkQueueSubmit(m_graphicsQueue, 1, &submitInfo, submitFence) != VK_SUCCESS)
+			{
+				throw std::runtime_error("fialed to submit draw command buffer!");
+			}
+		}
+
+		m_submittedFrames++;
+		m_frameSubmissions[m_currentFrame] = m_submittedFrames;
+		m_imageSubmissions[imageIndex] = m_submittedFrames;
+		m_gpuProfiler.markSubmitted(profilerSlot(imageIndex));
+		if (consumesUploads) {
+			retireUploads();
+		}
+
+		if (m_options.headless) {
+			m_currentFrame = (m_currentFrame + 1) % m_framesInFlight;
+			return;
 		}
 
 		//3. Use present Queue to draw on surface (use semaphores to wait for graphics queue)
 		VkPresentInfoKHR presentInfo = {};
 		presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;		
 		presentInfo.waitSemaphoreCount = 1;
-		presentInfo.pWaitSemaphores = signalSemaphores;
+		presentInfo.pWaitSemaphores = &m_renderFinishedSemaphores[m_currentFrame];
 		VkSwapchainKHR swapChains[] = { m_swapChain };
 		presentInfo.swapchainCount = 1;
 		presentInfo.pSwapchains = swapChains;
 		presentInfo.pImageIndices = &imageIndex;
 		presentInfo.pResults = nullptr;
 
-		result = vkQueuePresentKHR(m_presentQueue, &presentInfo);
+		{
+			TRACE_SCOPE("vkQueuePresentKHR");
+			result = vkQueuePresentKHR(m_presentQueue, &presentInfo);
+		}
 		
 		if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || m_framebufferResized) 
 		{
@@ -1093,19 +3524,27 @@ private:
 			throw std::runtime_error("failed to present swap chain image!");
 		}
 
-		m_currentFrame = (m_currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+		m_currentFrame = (m_currentFrame + 1) % m_framesInFlight;
 		//vkQueueWaitIdle(m_presentQueue);
 	}
 
 	//Member Data
+	AppOptions m_options;
+
+	//Declared first so it outlives every object allocated through it
+	HostAllocator m_hostAllocator;
+	uint64_t m_pipelineHostAllocations = 0;
 	GLFWwindow* m_window;
 
 	//Members for basic Vulkan setup
 	VkInstance m_vkInstance;
 	VkDebugUtilsMessengerEXT m_vkDebugMessenger;
+	DebugMessageSink m_debugSink;
 	VkSurfaceKHR m_vkSurface;
 	VkPhysicalDevice m_vkPhysicalDevice = VK_NULL_HANDLE;
+	DeviceCapabilities m_deviceCapabilities;
 	VkDevice m_vkLogicalDevice;
+	bool m_pipelineCreationFeedbackSupported = false;
 
 	//Members for SwapChain creation
 	VkQueue m_graphicsQueue;
@@ -1115,31 +3554,146 @@ private:
 	VkFormat m_swapChainImageFormat;
 	VkExtent2D m_swapChainExtent;
 	std::vector<VkImageView> m_swapChainImageViews;
+	std::vector<GpuAllocation> m_offscreenImageMemory;
+
+	GpuAllocator m_gpuAllocator;
+
+	//Members for Vertex Buffers
+	VkQueue m_transferQueue;
+	VkCommandPool m_transferCommandPool = VK_NULL_HANDLE;
+
+	//Uploads recorded during init, handed to the graphics queue by the first frame
+	struct PendingUploads {
+		VkCommandBuffer transferCommandBuffer = VK_NULL_HANDLE;
+		VkCommandBuffer acquireCommandBuffer = VK_NULL_HANDLE;
+		VkSemaphore semaphore = VK_NULL_HANDLE;
+		std::vector<VkBufferMemoryBarrier> acquireBarriers;
+		std::vector<std::pair<VkBuffer, GpuAllocation>> stagingBuffers;
+		VkDeviceSize bytes = 0;
+		bool submitted = false;
+	} m_pendingUploads;
+
+	//Async compute queue, the graphics queue where the device has no separate compute family
+	VkQueue m_computeQueue;
+	VkBuffer m_vertexBuffer = VK_NULL_HANDLE;
+	GpuAllocation m_vertexBufferMemory;
+	VkBuffer m_indexBuffer = VK_NULL_HANDLE;
+	GpuAllocation m_indexBufferMemory;
+
+	//Members for instanced rendering
+	VkBuffer m_instanceBuffer = VK_NULL_HANDLE;
+	GpuAllocation m_instanceBufferMemory;
+	uint32_t m_instanceIndexCount = static_cast<uint32_t>(quadIndices.size());
+	bool m_drawPerInstance = false;		//Naive path of the instancing benchmark
+	std::atomic<uint64_t> m_drawCallCount{ 0 };	//Recorded draw calls, from every recording thread
 	bool m_framebufferResized = false;
 
+	struct ResizeStats {
+		uint32_t count = 0;
+		double totalMs = 0.0;
+		double maxMs = 0.0;
+		uint64_t hostAllocations = 0;
+	} m_resizeStats;
+
 	//Members for Graphics pipeline creation
-	VkPipeline m_graphicsPipeline;
+	VkPipeline m_graphicsPipeline = VK_NULL_HANDLE;
 	VkRenderPass m_renderPass;
 	VkPipelineLayout m_pipelineLayout = {};
 	std::vector<VkFramebuffer> m_swapChainFramebuffers;
+	std::unique_ptr<RenderGraph> m_renderGraph;
+	DescriptorAllocator m_descriptorAllocator;
+	VkDescriptorSetLayout m_descriptorSetLayout = VK_NULL_HANDLE;	//Owned by m_descriptorAllocator, or m_bindlessTable
+	VkDescriptorSet m_uniformDescriptorSet = VK_NULL_HANDLE;
+	UniformRing m_uniformRing;
+	RenderGraph::Pass m_scenePass = 0;
+	RenderGraph::Resource m_backbuffer = 0;
+	PipelineCache m_pipelineCache;
+	AssetArchive m_assetArchive;
+	ShaderCompiler m_shaderCompiler;
+
+	//Members for asynchronous pipeline builds and shader hot reload
+	PipelineCompiler m_pipelineCompiler;
+	std::future<VkPipeline> m_pendingPipeline;
+	std::chrono::high_resolution_clock::time_point m_pendingPipelineStart;
+	uint32_t m_framesWithoutPipeline = 0;
+
+	struct HotReload {
+		bool dirty = false;
+		std::chrono::high_resolution_clock::time_point lastChange;
+
+		uint32_t count = 0;
+		uint32_t failures = 0;
+		double totalMs = 0.0;
+		double maxMs = 0.0;
+	} m_hotReload;
+	FileWatcher m_shaderWatcher;
 
 	//Members for Drawing
 	VkCommandPool m_commandPool;
 	std::vector<VkCommandBuffer> m_commandBuffers;
+	std::vector<VkCommandPool> m_frameCommandPools;
+	std::vector<VkCommandBuffer> m_frameCommandBuffers;
+
+	//Members for multi-threaded recording, worker pools are indexed [frame * threadCount + worker]
+	struct WorkerCommandPool {
+		VkCommandPool commandPool = VK_NULL_HANDLE;
+		std::vector<VkCommandBuffer> commandBuffers;
+		size_t usedCount = 0;
+	};
+	std::unique_ptr<ThreadPool> m_threadPool;
+	std::vector<WorkerCommandPool> m_workerCommandPools;
+
+	struct RecordStats {
+		uint32_t count = 0;
+		double lastMs = 0.0;
+		double totalMs = 0.0;
+		double maxMs = 0.0;
+	} m_recordStats;
 
 	//Members for Presentation
+	FrameStats m_frameStats;
+	GpuProfiler m_gpuProfiler;
 	size_t m_currentFrame = 0;
 	std::vector<VkSemaphore> m_imageAvailableSemaphores;
 	std::vector<VkSemaphore> m_renderFinishedSemaphores;
 	std::vector<VkFence> m_inFLightFences;	 
 	std::vector<VkFence> m_imagesInFlight;
+	uint32_t m_framesInFlight;
+
+	//Members for bindless descriptors
+	bool m_bindlessEnabled = false;
+	BindlessTable m_bindlessTable;
+	uint32_t m_drawBufferIndex = 0;		//The uniform ring in the bindless storage buffer array
+
+	//Members for timeline semaphore frame pacing
+	bool m_timelineSemaphoresEnabled = false;
+	VkSemaphore m_frameTimeline = VK_NULL_HANDLE;
+	PFN_vkWaitSemaphoresKHR m_pfnWaitSemaphores = nullptr;
+	PFN_vkGetSemaphoreCounterValueKHR m_pfnGetSemaphoreCounterValue = nullptr;
+
+	//Members for deferred destruction
+	struct DeferredDestruction {
+		uint64_t submittedFrames;
+		std::function<void()> destroy;
+	};
+	std::deque<DeferredDestruction> m_deferredDestructions;
+	uint64_t m_submittedFrames = 0;
+	uint64_t m_completedFrames = 0;
+	std::vector<uint64_t> m_frameSubmissions;
+	std::vector<uint64_t> m_imageSubmissions;
 };
 
-int main() {
+int main(int argc, char** argv) {
 
 
 	try {
-		HelloTriangleApplication app;
+		AppOptions options = parseOptions(argc, argv);
+		if (!options.packArchive.empty()) {
+			packDirectory(options.packArchive, options.packDirectory);
+			return EXIT_SUCCESS;
+		}
+
+		HelloTriangleApplication app(options);
 		app.run();
 	}
 	catch (const std::exception& e) {
@@ -0,0 +1,88 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+//Bounded lock-free queue for many producers and a single consumer.
+//Every cell carries a sequence number telling producers and the consumer whose turn it is,
+//so push() and pop() are a handful of atomics and never block. push() fails when the queue is full.
+template<typename T>
+class MpscQueue {
+public:
+	//capacity_ is rounded up to a power of two
+	explicit MpscQueue(size_t capacity_)
+	{
+		size_t capacity = 2;
+		while (capacity < capacity_) {
+			capacity <<= 1;
+		}
+
+		m_mask = capacity - 1;
+		m_cells.reset(new Cell[capacity]);
+		for (size_t i = 0; i < capacity; i++) {
+			m_cells[i].sequence.store(i, std::memory_order_relaxed);
+		}
+	}
+
+	MpscQueue(const MpscQueue&) = delete;
+	MpscQueue& operator=(const MpscQueue&) = delete;
+
+	//Safe to call from any thread
+	bool push(T&& value_)
+	{
+		Cell* cell;
+		size_t position = m_enqueuePosition.load(std::memory_order_relaxed);
+
+		for (;;) {
+			cell = &m_cells[position & m_mask];
+			size_t sequence = cell->sequence.load(std::memory_order_acquire);
+			intptr_t difference = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position);
+
+			if (difference == 0) {
+				if (m_enqueuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+					break;
+				}
+			}
+			else if (difference < 0) {
+				return false;
+			}
+			else {
+				position = m_enqueuePosition.load(std::memory_order_relaxed);
+			}
+		}
+
+		cell->value = std::move(value_);
+		cell->sequence.store(position + 1, std::memory_order_release);
+		return true;
+	}
+
+	//Must only be called from the consumer thread
+	bool pop(T& value_)
+	{
+		Cell& cell = m_cells[m_dequeuePosition & m_mask];
+		size_t sequence = cell.sequence.load(std::memory_order_acquire);
+
+		if (static_cast<intptr_t>(sequence) - static_cast<intptr_t>(m_dequeuePosition + 1) < 0) {
+			return false;
+		}
+
+		value_ = std::move(cell.value);
+		cell.sequence.store(m_dequeuePosition + m_mask + 1, std::memory_order_release);
+		m_dequeuePosition++;
+		return true;
+	}
+
+private:
+	struct Cell {
+		std::atomic<size_t> sequence;
+		T value;
+	};
+
+	std::unique_ptr<Cell[]> m_cells;
+	size_t m_mask = 0;
+
+	//Kept on separate cache lines so producers and the consumer do not contend on them
+	alignas(64) std::atomic<size_t> m_enqueuePosition{ 0 };
+	alignas(64) size_t m_dequeuePosition = 0;
+};
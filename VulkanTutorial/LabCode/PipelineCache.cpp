@@ -0,0 +1,241 @@
+#include "PipelineCache.h"
+
+#include <iostream>
+#include <fstream>
+#include <stdexcept>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <cstdio>
+
+namespace {
+	const uint32_t PIPELINE_CACHE_MAGIC = 0x31435050; //"PPC1"
+}
+
+void PipelineCache::create(VkDevice device_, VkPhysicalDevice physicalDevice_, const std::string& filename_, bool feedbackSupported_, const VkAllocationCallbacks* pAllocator_)
+{
+	m_device = device_;
+	m_pAllocator = pAllocator_;
+	m_filename = filename_;
+	m_feedbackSupported = feedbackSupported_;
+	vkGetPhysicalDeviceProperties(physicalDevice_, &m_deviceProperties);
+
+	//1. Load the previous blob, it is only handed to the driver if it was produced by this exact device and driver
+	//The driver reads the blob straight from the mapping, which is released once the cache is created
+	FileView file;
+	bool loaded = loadFromDisk(file);
+
+	//2. Create the cache, seeded with the blob if we have one
+	VkPipelineCacheCreateInfo createInfo = {};
+	createInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+	createInfo.initialDataSize = loaded ? file.size() - sizeof(FileHeader) : 0;
+	createInfo.pInitialData = loaded ? file.data() + sizeof(FileHeader) : nullptr;
+
+	if (vkCreatePipelineCache(m_device, &createInfo, m_pAllocator, &m_cache) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create pipeline cache! [PipelineCache::create]");
+	}
+}
+
+void PipelineCache::destroy()
+{
+	if (m_cache == VK_NULL_HANDLE) {
+		return;
+	}
+
+	save();
+	vkDestroyPipelineCache(m_device, m_cache, m_pAllocator);
+	m_cache = VK_NULL_HANDLE;
+}
+
+void PipelineCache::save()
+{
+	size_t dataSize = currentDataSize();
+	if (dataSize == 0) {
+		return;
+	}
+
+	std::vector<char> data(dataSize);
+	if (vkGetPipelineCacheData(m_device, m_cache, &dataSize, data.data()) != VK_SUCCESS) {
+		std::cerr << "failed to retrieve pipeline cache data [PipelineCache::save]" << std::endl;
+		return;
+	}
+
+	FileHeader header = {};
+	header.magic = PIPELINE_CACHE_MAGIC;
+	header.headerSize = sizeof(FileHeader);
+	header.vendorID = m_deviceProperties.vendorID;
+	header.deviceID = m_deviceProperties.deviceID;
+	header.driverVersion = m_deviceProperties.driverVersion;
+	memcpy(header.pipelineCacheUUID, m_deviceProperties.pipelineCacheUUID, VK_UUID_SIZE);
+	header.dataSize = dataSize;
+	header.coldCompileMs = m_stats.coldCompileMs;
+
+	//Write to a temporary file first so a crash while saving never leaves a truncated cache behind
+	std::string tmpFilename = m_filename + ".tmp";
+	{
+		std::ofstream file(tmpFilename, std::ios::binary | std::ios::trunc);
+		if (!file.is_open()) {
+			std::cerr << "failed to open '" << tmpFilename << "' for writing [PipelineCache::save]" << std::endl;
+			return;
+		}
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		file.write(data.data(), dataSize);
+		file.close();
+
+		//A short write must never replace the cache that is already on disk
+		if (!file.good()) {
+			std::remove(tmpFilename.c_str());
+			std::cerr << "failed to write '" << tmpFilename << "' [PipelineCache::save]" << std::endl;
+			return;
+		}
+	}
+
+	std::remove(m_filename.c_str());
+	if (std::rename(tmpFilename.c_str(), m_filename.c_str()) != 0) {
+		std::cerr << "failed to replace '" << m_filename << "' [PipelineCache::save]" << std::endl;
+	}
+}
+
+VkResult PipelineCache::createGraphicsPipelines(uint32_t createInfoCount_, const VkGraphicsPipelineCreateInfo* pCreateInfos_, VkPipeline* pPipelines_)
+{
+	//1. Chain creation feedback so the driver tells us whether the cache was hit
+	std::vector<VkGraphicsPipelineCreateInfo> createInfos(pCreateInfos_, pCreateInfos_ + createInfoCount_);
+	std::vector<VkPipelineCreationFeedbackEXT> pipelineFeedbacks(createInfoCount_);
+	std::vector<std::vector<VkPipelineCreationFeedbackEXT>> stageFeedbacks(createInfoCount_);
+	std::vector<VkPipelineCreationFeedbackCreateInfoEXT> feedbackInfos(createInfoCount_);
+
+	if (m_feedbackSupported) {
+		for (uint32_t i = 0; i < createInfoCount_; i++) {
+			stageFeedbacks[i].resize(createInfos[i].stageCount);
+
+			feedbackInfos[i].sType = VK_STRUCTURE_TYPE_PIPELINE_CREATION_FEEDBACK_CREATE_INFO_EXT;
+			feedbackInfos[i].pNext = createInfos[i].pNext;
+			feedbackInfos[i].pPipelineCreationFeedback = &pipelineFeedbacks[i];
+			feedbackInfos[i].pipelineStageCreationFeedbackCount = createInfos[i].stageCount;
+			feedbackInfos[i].pPipelineStageCreationFeedbacks = stageFeedbacks[i].data();
+			createInfos[i].pNext = &feedbackInfos[i];
+		}
+	}
+
+	//2. Create the pipelines and time them
+	size_t sizeBefore = m_feedbackSupported ? 0 : currentDataSize();
+
+	auto start = std::chrono::high_resolution_clock::now();
+	VkResult result = vkCreateGraphicsPipelines(m_device, m_cache, createInfoCount_, createInfos.data(), m_pAllocator, pPipelines_);
+	auto end = std::chrono::high_resolution_clock::now();
+
+	if (result != VK_SUCCESS) {
+		return result;
+	}
+
+	//3. Classify each pipeline as hit or miss.
+	//Without feedback a growing cache blob means the driver had to insert a freshly compiled pipeline,
+	//which can misclassify pipelines created concurrently on other threads.
+	std::lock_guard<std::mutex> lock(m_statsMutex);
+	double perPipelineMs = std::chrono::duration<double, std::milli>(end - start).count() / createInfoCount_;
+	bool grew = !m_feedbackSupported && currentDataSize() > sizeBefore;
+
+	for (uint32_t i = 0; i < createInfoCount_; i++) {
+		bool hit = false;
+		if (m_feedbackSupported && (pipelineFeedbacks[i].flags & VK_PIPELINE_CREATION_FEEDBACK_VALID_BIT_EXT)) {
+			hit = (pipelineFeedbacks[i].flags & VK_PIPELINE_CREATION_FEEDBACK_APPLICATION_PIPELINE_CACHE_HIT_BIT_EXT) != 0;
+		}
+		else {
+			hit = !grew;
+		}
+
+		if (hit) {
+			m_stats.hits++;
+			m_stats.hitMs += perPipelineMs;
+		}
+		else {
+			m_stats.misses++;
+			m_stats.missMs += perPipelineMs;
+			m_stats.coldCompileMs = m_stats.missMs / m_stats.misses;
+		}
+	}
+
+	return result;
+}
+
+PipelineCache::Stats PipelineCache::stats() const
+{
+	std::lock_guard<std::mutex> lock(m_statsMutex);
+	return m_stats;
+}
+
+double PipelineCache::timeSavedMs() const
+{
+	Stats stats = this->stats();
+	if (stats.hits == 0 || stats.coldCompileMs <= 0.0) {
+		return 0.0;
+	}
+
+	double averageHitMs = stats.hitMs / stats.hits;
+	return stats.hits * std::max(0.0, stats.coldCompileMs - averageHitMs);
+}
+
+void PipelineCache::printStats() const
+{
+	Stats stats = this->stats();
+	std::cout << "pipeline cache: " << stats.hits << " hits, " << stats.misses << " misses"
+		<< ", hit time " << stats.hitMs << " ms, miss time " << stats.missMs << " ms"
+		<< ", estimated time saved " << timeSavedMs() << " ms" << std::endl;
+}
+
+bool PipelineCache::loadFromDisk(FileView& file_)
+{
+	if (!file_.tryOpen(m_filename) || file_.size() < sizeof(FileHeader)) {
+		return false;
+	}
+
+	const FileHeader& header = *file_.as<FileHeader>();
+	if (header.magic != PIPELINE_CACHE_MAGIC || header.headerSize != sizeof(FileHeader)
+		|| header.dataSize != file_.size() - sizeof(FileHeader)) {
+		std::cout << "pipeline cache '" << m_filename << "' is corrupt, starting cold" << std::endl;
+		return false;
+	}
+
+	if (!isCompatible(header, file_.data() + sizeof(FileHeader), header.dataSize)) {
+		std::cout << "pipeline cache '" << m_filename << "' was built for another device or driver, starting cold" << std::endl;
+		return false;
+	}
+
+	m_stats.coldCompileMs = header.coldCompileMs;
+	return true;
+}
+
+bool PipelineCache::isCompatible(const FileHeader& header_, const char* data_, size_t size_) const
+{
+	//1. Our header, this is the only place the driver version is recorded
+	if (header_.vendorID != m_deviceProperties.vendorID
+		|| header_.deviceID != m_deviceProperties.deviceID
+		|| header_.driverVersion != m_deviceProperties.driverVersion
+		|| memcmp(header_.pipelineCacheUUID, m_deviceProperties.pipelineCacheUUID, VK_UUID_SIZE) != 0) {
+		return false;
+	}
+
+	//2. The driver's own header (VkPipelineCacheHeaderVersionOne layout) at the start of the blob
+	const size_t driverHeaderSize = 16 + VK_UUID_SIZE;
+	if (size_ < driverHeaderSize) {
+		return false;
+	}
+
+	uint32_t driverHeader[4];
+	memcpy(driverHeader, data_, sizeof(driverHeader));
+
+	return driverHeader[0] >= driverHeaderSize
+		&& driverHeader[1] == VK_PIPELINE_CACHE_HEADER_VERSION_ONE
+		&& driverHeader[2] == m_deviceProperties.vendorID
+		&& driverHeader[3] == m_deviceProperties.deviceID
+		&& memcmp(data_ + 16, m_deviceProperties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+}
+
+size_t PipelineCache::currentDataSize() const
+{
+	size_t dataSize = 0;
+	if (vkGetPipelineCacheData(m_device, m_cache, &dataSize, nullptr) != VK_SUCCESS) {
+		return 0;
+	}
+	return dataSize;
+}
@@ -0,0 +1,64 @@
+#pragma once
+#include <vulkan/vulkan.h>
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <mutex>
+
+#include "FileView.h"
+
+//Persistent VkPipelineCache shared by every pipeline creation.
+//The blob is loaded from disk at startup, validated against the device it was produced on
+//and written back on destroy(). Hits and misses are counted per created pipeline.
+//createGraphicsPipelines() may be called from several threads at once.
+class PipelineCache {
+public:
+	struct Stats {
+		uint32_t hits = 0;
+		uint32_t misses = 0;
+		double hitMs = 0.0;		//Total creation time of pipelines served from the cache
+		double missMs = 0.0;	//Total creation time of pipelines compiled from scratch
+		double coldCompileMs = 0.0; //Average compile time of a miss, persisted across runs
+	};
+
+	void create(VkDevice device_, VkPhysicalDevice physicalDevice_, const std::string& filename_, bool feedbackSupported_, const VkAllocationCallbacks* pAllocator_);
+	void destroy();
+	void save();
+
+	//Drop in replacement for vkCreateGraphicsPipelines which records cache statistics
+	VkResult createGraphicsPipelines(uint32_t createInfoCount_, const VkGraphicsPipelineCreateInfo* pCreateInfos_, VkPipeline* pPipelines_);
+
+	VkPipelineCache handle() const { return m_cache; }
+	Stats stats() const;
+	double timeSavedMs() const;
+	void printStats() const;
+
+private:
+	//On-disk header written in front of the driver blob. The driver blob header carries
+	//vendor, device and cache UUID but not the driver version, so we store all of them here.
+	struct FileHeader {
+		uint32_t magic;
+		uint32_t headerSize;
+		uint32_t vendorID;
+		uint32_t deviceID;
+		uint32_t driverVersion;
+		uint8_t pipelineCacheUUID[VK_UUID_SIZE];
+		uint64_t dataSize;
+		double coldCompileMs;
+	};
+
+	bool loadFromDisk(FileView& file_);
+	bool isCompatible(const FileHeader& header_, const char* data_, size_t size_) const;
+	size_t currentDataSize() const;
+
+	VkDevice m_device = VK_NULL_HANDLE;
+	const VkAllocationCallbacks* m_pAllocator = nullptr;
+	VkPhysicalDeviceProperties m_deviceProperties = {};
+	VkPipelineCache m_cache = VK_NULL_HANDLE;
+	std::string m_filename;
+	bool m_feedbackSupported = false;
+
+	mutable std::mutex m_statsMutex;
+	Stats m_stats;
+};
@@ -0,0 +1,69 @@
+#include "PipelineCompiler.h"
+#include "CpuTrace.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+
+void PipelineCompiler::create(uint32_t threadCount_)
+{
+	m_threadPool = std::make_unique<ThreadPool>(std::max(1u, threadCount_));
+}
+
+void PipelineCompiler::destroy()
+{
+	//The pool finishes every queued job before its workers exit
+	m_threadPool.reset();
+}
+
+std::future<VkPipeline> PipelineCompiler::submit(const std::string& name_, BuildFunction build_)
+{
+	auto queued = std::chrono::high_resolution_clock::now();
+
+	return m_threadPool->submit([this, name_, build_, queued](uint32_t) {
+		TRACE_SCOPE("compilePipeline");
+
+		auto start = std::chrono::high_resolution_clock::now();
+		VkPipeline pipeline = VK_NULL_HANDLE;
+		try {
+			pipeline = build_();
+		}
+		catch (...) {
+			std::lock_guard<std::mutex> lock(m_statsMutex);
+			m_stats.failed++;
+			throw;
+		}
+		auto end = std::chrono::high_resolution_clock::now();
+
+		double compileMs = std::chrono::duration<double, std::milli>(end - start).count();
+
+		std::lock_guard<std::mutex> lock(m_statsMutex);
+		m_stats.completed++;
+		m_stats.queueMs += std::chrono::duration<double, std::milli>(start - queued).count();
+		m_stats.compileMs += compileMs;
+		m_stats.maxCompileMs = std::max(m_stats.maxCompileMs, compileMs);
+		return pipeline;
+	});
+}
+
+PipelineCompiler::Stats PipelineCompiler::stats() const
+{
+	std::lock_guard<std::mutex> lock(m_statsMutex);
+	return m_stats;
+}
+
+void PipelineCompiler::printStats() const
+{
+	Stats stats = this->stats();
+	if (stats.completed == 0 && stats.failed == 0) {
+		return;
+	}
+
+	std::cout << "pipeline compiler: " << stats.completed << " built, " << stats.failed << " failed";
+	if (stats.completed > 0) {
+		std::cout << ", avg queue " << stats.queueMs / stats.completed << " ms"
+			<< ", avg compile " << stats.compileMs / stats.completed << " ms"
+			<< ", max compile " << stats.maxCompileMs << " ms";
+	}
+	std::cout << std::endl;
+}
@@ -0,0 +1,43 @@
+#pragma once
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "ThreadPool.h"
+
+//Creates pipelines on worker threads so driver compilation never stalls the thread that draws.
+//A job builds its VkGraphicsPipelineCreateInfo on the worker, so the state structs it points at live on the
+//worker's stack for the whole vkCreateGraphicsPipelines call. The returned future rethrows a failed build.
+class PipelineCompiler {
+public:
+	using BuildFunction = std::function<VkPipeline()>;
+
+	struct Stats {
+		uint32_t completed = 0;
+		uint32_t failed = 0;
+		double queueMs = 0.0;		//Total time jobs waited for a free worker
+		double compileMs = 0.0;		//Total time spent inside the build functions
+		double maxCompileMs = 0.0;
+	};
+
+	void create(uint32_t threadCount_);
+
+	//Waits for the queued jobs, the pipelines they produce must still be collected and destroyed by the caller
+	void destroy();
+
+	std::future<VkPipeline> submit(const std::string& name_, BuildFunction build_);
+
+	Stats stats() const;
+	void printStats() const;
+
+private:
+	std::unique_ptr<ThreadPool> m_threadPool;
+
+	mutable std::mutex m_statsMutex;
+	Stats m_stats;
+};
@@ -0,0 +1,645 @@
+#include "RenderGraph.h"
+
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+
+void RenderGraph::create(VkDevice device_, GpuAllocator* gpuAllocator_, const VkAllocationCallbacks* pAllocator_)
+{
+	m_device = device_;
+	m_gpuAllocator = gpuAllocator_;
+	m_pAllocator = pAllocator_;
+}
+
+void RenderGraph::destroy()
+{
+	for (PassNode& pass : m_passes) {
+		for (auto& entry : pass.framebuffers) {
+			vkDestroyFramebuffer(m_device, entry.second, m_pAllocator);
+		}
+		if (pass.renderPass != VK_NULL_HANDLE) {
+			vkDestroyRenderPass(m_device, pass.renderPass, m_pAllocator);
+		}
+	}
+
+	for (ResourceNode& resource : m_resources) {
+		if (resource.imported) {
+			continue;
+		}
+		if (resource.view != VK_NULL_HANDLE) {
+			vkDestroyImageView(m_device, resource.view, m_pAllocator);
+		}
+		if (resource.image != VK_NULL_HANDLE) {
+			vkDestroyImage(m_device, resource.image, m_pAllocator);
+		}
+	}
+
+	if (m_transientMemory.memory != VK_NULL_HANDLE) {
+		m_gpuAllocator->free(m_transientMemory);
+	}
+
+	m_passes.clear();
+	m_resources.clear();
+	m_finalBarriers.clear();
+	m_compiled = false;
+	m_stats = Stats();
+}
+
+RenderGraph::Resource RenderGraph::createImage(const std::string& name_, VkFormat format_, VkExtent2D extent_)
+{
+	ResourceNode resource;
+	resource.name = name_;
+	resource.format = format_;
+	resource.extent = extent_;
+	m_resources.push_back(resource);
+	return static_cast<Resource>(m_resources.size() - 1);
+}
+
+RenderGraph::Resource RenderGraph::importImage(const std::string& name_, VkFormat format_, VkExtent2D extent_,
+	VkImageLayout initialLayout_, VkPipelineStageFlags initialStage_, VkImageLayout finalLayout_)
+{
+	ResourceNode resource;
+	resource.name = name_;
+	resource.format = format_;
+	resource.extent = extent_;
+	resource.imported = true;
+	resource.initialLayout = initialLayout_;
+	resource.initialStage = initialStage_;
+	resource.finalLayout = finalLayout_;
+	m_resources.push_back(resource);
+	return static_cast<Resource>(m_resources.size() - 1);
+}
+
+RenderGraph::Pass RenderGraph::addPass(const std::string& name_, ExecuteFunction execute_, VkSubpassContents contents_)
+{
+	if (m_compiled) {
+		throw std::runtime_error("render graph is already compiled [RenderGraph::addPass]");
+	}
+
+	PassNode pass;
+	pass.name = name_;
+	pass.execute = std::move(execute_);
+	pass.contents = contents_;
+	m_passes.push_back(std::move(pass));
+	return static_cast<Pass>(m_passes.size() - 1);
+}
+
+void RenderGraph::read(Pass pass_, Resource resource_, Usage usage_)
+{
+	if (usage_ == Usage::ColorAttachment || usage_ == Usage::TransferDst) {
+		throw std::runtime_error("'" + m_resources[resource_].name + "' can not be read as a write usage [RenderGraph::read]");
+	}
+	for (const Use& use : m_passes[pass_].uses) {
+		if (use.resource == resource_) {
+			throw std::runtime_error("'" + m_resources[resource_].name + "' is used twice by pass '" + m_passes[pass_].name + "' [RenderGraph::read]");
+		}
+	}
+	m_passes[pass_].uses.push_back({ resource_, usage_, false });
+}
+
+void RenderGraph::write(Pass pass_, Resource resource_, Usage usage_)
+{
+	if (usage_ == Usage::Sampled || usage_ == Usage::TransferSrc) {
+		throw std::runtime_error("'" + m_resources[resource_].name + "' can not be written as a read usage [RenderGraph::write]");
+	}
+	for (const Use& use : m_passes[pass_].uses) {
+		if (use.resource == resource_) {
+			throw std::runtime_error("'" + m_resources[resource_].name + "' is used twice by pass '" + m_passes[pass_].name + "' [RenderGraph::write]");
+		}
+	}
+	m_passes[pass_].uses.push_back({ resource_, usage_, true });
+}
+
+void RenderGraph::compile()
+{
+	if (m_compiled) {
+		throw std::runtime_error("render graph is already compiled [RenderGraph::compile]");
+	}
+
+	//1. Drop passes nothing depends on
+	cullPasses();
+
+	//2. Lifetimes, load ops and barriers, walking the live passes in order
+	computeBarriers();
+
+	//3. Images and their aliased memory, which completes the barriers of first uses
+	placeTransients();
+
+	//4. One single subpass render pass per pass with color attachments
+	createRenderPasses();
+
+	m_compiled = true;
+}
+
+void RenderGraph::cullPasses()
+{
+	//Imported images are the graph's outputs. Walking backwards, a pass is live if it writes something a live
+	//pass or an output needs, and then everything it reads is needed as well.
+	std::vector<bool> needed(m_resources.size(), false);
+	for (size_t i = 0; i < m_resources.size(); i++) {
+		needed[i] = m_resources[i].imported;
+	}
+
+	m_stats.passes = static_cast<uint32_t>(m_passes.size());
+	m_stats.culledPasses = 0;
+	for (size_t i = m_passes.size(); i-- > 0;) {
+		PassNode& pass = m_passes[i];
+		pass.live = false;
+		for (const Use& use : pass.uses) {
+			if (use.write && needed[use.resource]) {
+				pass.live = true;
+			}
+		}
+
+		if (!pass.live) {
+			m_stats.culledPasses++;
+			continue;
+		}
+
+		//A color write after an earlier one loads it, so the earlier writer stays needed either way
+		for (const Use& use : pass.uses) {
+			if (!use.write) {
+				needed[use.resource] = true;
+			}
+		}
+	}
+}
+
+void RenderGraph::computeBarriers()
+{
+	struct State {
+		bool used = false;
+		VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+		VkPipelineStageFlags writeStage = 0;
+		VkAccessFlags writeAccess = 0;
+		VkPipelineStageFlags readStages = 0;	//Since the last write
+		VkPipelineStageFlags visibleStages = 0;	//Reading stages the last write was made visible to
+	};
+	std::vector<State> states(m_resources.size());
+
+	uint32_t livePass = 0;
+	for (PassNode& pass : m_passes) {
+		if (!pass.live) {
+			continue;
+		}
+
+		for (const Use& use : pass.uses) {
+			ResourceNode& resource = m_resources[use.resource];
+			State& state = states[use.resource];
+
+			if (!state.used && !use.write && !resource.imported) {
+				throw std::runtime_error("pass '" + pass.name + "' reads '" + resource.name + "' before anything writes it [RenderGraph::compile]");
+			}
+
+			bool load = use.usage == Usage::ColorAttachment && state.used;
+			UsageState target = usageState(use.usage, load);
+
+			Barrier barrier = { use.resource, state.layout, target.layout, state.writeStage | state.readStages, target.stage, state.writeAccess, target.access, false };
+			bool needBarrier = false;
+			if (!state.used) {
+				//Transients start undefined, their source scope is only known once memory is placed
+				barrier.oldLayout = resource.imported ? resource.initialLayout : VK_IMAGE_LAYOUT_UNDEFINED;
+				barrier.srcStage = resource.imported ? resource.initialStage : 0;
+				barrier.srcAccess = 0;
+				barrier.firstUse = !resource.imported;
+				needBarrier = true;
+			}
+			else if (state.layout != target.layout) {
+				needBarrier = true;
+			}
+			else if (use.write) {
+				//Write after write or after read, in the same layout
+				needBarrier = barrier.srcStage != 0;
+			}
+			else {
+				//Read after read needs nothing once the last write is visible to this stage
+				needBarrier = state.writeAccess != 0 && (target.stage & ~state.visibleStages) != 0;
+			}
+
+			if (needBarrier) {
+				pass.barriers.push_back(barrier);
+			}
+
+			if (use.write) {
+				state.writeStage = target.stage;
+				state.writeAccess = target.access;
+				state.readStages = 0;
+				state.visibleStages = 0;
+			}
+			else {
+				state.readStages |= target.stage;
+				if (needBarrier) {
+					state.visibleStages |= target.stage;
+				}
+			}
+			state.used = true;
+			state.layout = target.layout;
+
+			resource.firstPass = std::min(resource.firstPass, livePass);
+			resource.lastPass = std::max(resource.lastPass, livePass);
+			resource.useStages |= target.stage;
+			resource.writeAccess |= use.write ? target.access : 0;
+			resource.usage |= imageUsage(use.usage);
+
+			if (use.usage == Usage::ColorAttachment) {
+				pass.colorAttachments.push_back(use.resource);
+				pass.loadOps.push_back(load ? VK_ATTACHMENT_LOAD_OP_LOAD : VK_ATTACHMENT_LOAD_OP_CLEAR);
+
+				VkClearValue clearValue = {};
+				clearValue.color = { { 0.f, 0.f, 0.f, 1.f } };
+				pass.clearValues.push_back(clearValue);
+			}
+		}
+
+		livePass++;
+	}
+
+	//Hand imported images back in the layout their owner expects
+	for (size_t i = 0; i < m_resources.size(); i++) {
+		const ResourceNode& resource = m_resources[i];
+		const State& state = states[i];
+		if (resource.imported && state.used && state.layout != resource.finalLayout) {
+			m_finalBarriers.push_back({ static_cast<Resource>(i), state.layout, resource.finalLayout,
+				state.writeStage | state.readStages, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, state.writeAccess, 0, false });
+		}
+	}
+
+	m_stats.imageBarriers = static_cast<uint32_t>(m_finalBarriers.size());
+	m_stats.barrierBatches = m_finalBarriers.empty() ? 0 : 1;
+	for (const PassNode& pass : m_passes) {
+		m_stats.imageBarriers += static_cast<uint32_t>(pass.barriers.size());
+		m_stats.barrierBatches += pass.barriers.empty() ? 0 : 1;
+	}
+}
+
+void RenderGraph::placeTransients()
+{
+	//1. Create every transient some live pass uses, memory requirements decide the placement
+	std::vector<Resource> transients;
+	uint32_t memoryTypeBits = ~0u;
+	VkDeviceSize alignment = 1;
+	for (size_t i = 0; i < m_resources.size(); i++) {
+		ResourceNode& resource = m_resources[i];
+		if (resource.imported || resource.firstPass == UINT32_MAX) {
+			continue;
+		}
+
+		VkImageCreateInfo imageInfo = {};
+		imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+		imageInfo.imageType = VK_IMAGE_TYPE_2D;
+		imageInfo.format = resource.format;
+		imageInfo.extent = { resource.extent.width, resource.extent.height, 1 };
+		imageInfo.mipLevels = 1;
+		imageInfo.arrayLayers = 1;
+		imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+		imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+		imageInfo.usage = resource.usage;
+		imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+		if (vkCreateImage(m_device, &imageInfo, m_pAllocator, &resource.image) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create transient image '" + resource.name + "'! [RenderGraph::placeTransients]");
+		}
+		vkGetImageMemoryRequirements(m_device, resource.image, &resource.requirements);
+
+		memoryTypeBits &= resource.requirements.memoryTypeBits;
+		alignment = std::max(alignment, resource.requirements.alignment);
+		transients.push_back(static_cast<Resource>(i));
+	}
+
+	m_stats.transientImages = static_cast<uint32_t>(transients.size());
+	if (transients.empty()) {
+		return;
+	}
+	if (memoryTypeBits == 0) {
+		throw std::runtime_error("transient images have no memory type in common [RenderGraph::placeTransients]");
+	}
+
+	//2. Largest first, each at the lowest offset not overlapping a placed image whose lifetime overlaps its own
+	std::sort(transients.begin(), transients.end(), [&](Resource a_, Resource b_) {
+		return m_resources[a_].requirements.size > m_resources[b_].requirements.size;
+	});
+
+	auto livesOverlap = [&](const ResourceNode& a_, const ResourceNode& b_) {
+		return a_.firstPass <= b_.lastPass && b_.firstPass <= a_.lastPass;
+	};
+	auto bytesOverlap = [&](const ResourceNode& a_, const ResourceNode& b_) {
+		return a_.memoryOffset < b_.memoryOffset + b_.requirements.size && b_.memoryOffset < a_.memoryOffset + a_.requirements.size;
+	};
+
+	std::vector<Resource> placed;
+	m_stats.transientBytes = 0;
+	m_stats.peakBytes = 0;
+	for (Resource handle : transients) {
+		ResourceNode& resource = m_resources[handle];
+		VkDeviceSize align = resource.requirements.alignment;
+
+		std::vector<VkDeviceSize> candidates = { 0 };
+		for (Resource other : placed) {
+			const ResourceNode& node = m_resources[other];
+			if (livesOverlap(resource, node)) {
+				candidates.push_back((node.memoryOffset + node.requirements.size + align - 1) / align * align);
+			}
+		}
+		std::sort(candidates.begin(), candidates.end());
+
+		for (VkDeviceSize offset : candidates) {
+			resource.memoryOffset = offset;
+			bool fits = true;
+			for (Resource other : placed) {
+				if (livesOverlap(resource, m_resources[other]) && bytesOverlap(resource, m_resources[other])) {
+					fits = false;
+					break;
+				}
+			}
+			if (fits) {
+				break;
+			}
+		}
+
+		placed.push_back(handle);
+		m_stats.transientBytes += resource.requirements.size;
+		m_stats.peakBytes = std::max(m_stats.peakBytes, resource.memoryOffset + resource.requirements.size);
+	}
+
+	//3. One allocation for all of them
+	VkMemoryRequirements requirements = {};
+	requirements.size = m_stats.peakBytes;
+	requirements.alignment = alignment;
+	requirements.memoryTypeBits = memoryTypeBits;
+	m_gpuAllocator->allocate(requirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, GpuAllocator::ResourceKind::Optimal, m_transientMemory);
+
+	m_stats.aliasedImages = 0;
+	for (Resource handle : transients) {
+		ResourceNode& resource = m_resources[handle];
+		vkBindImageMemory(m_device, resource.image, m_transientMemory.memory, m_transientMemory.offset + resource.memoryOffset);
+
+		VkImageViewCreateInfo viewInfo = {};
+		viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+		viewInfo.image = resource.image;
+		viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		viewInfo.format = resource.format;
+		viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		viewInfo.subresourceRange.levelCount = 1;
+		viewInfo.subresourceRange.layerCount = 1;
+		if (vkCreateImageView(m_device, &viewInfo, m_pAllocator, &resource.view) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create transient image view '" + resource.name + "'! [RenderGraph::placeTransients]");
+		}
+
+		for (Resource other : transients) {
+			if (other != handle && bytesOverlap(resource, m_resources[other])) {
+				m_stats.aliasedImages++;
+				break;
+			}
+		}
+	}
+
+	//4. The first use of a transient waits for the last use of everything sharing its bytes, including itself in the
+	//previous frame. Its contents are undefined anyway, so only the ordering and earlier writes matter.
+	for (PassNode& pass : m_passes) {
+		for (Barrier& barrier : pass.barriers) {
+			if (!barrier.firstUse) {
+				continue;
+			}
+			const ResourceNode& resource = m_resources[barrier.resource];
+			for (Resource other : transients) {
+				if (bytesOverlap(resource, m_resources[other])) {
+					barrier.srcStage |= m_resources[other].useStages;
+					barrier.srcAccess |= m_resources[other].writeAccess;
+				}
+			}
+		}
+	}
+}
+
+void RenderGraph::createRenderPasses()
+{
+	for (uint32_t i = 0, livePass = 0; i < m_passes.size(); i++) {
+		PassNode& pass = m_passes[i];
+		if (!pass.live) {
+			continue;
+		}
+		uint32_t passIndex = livePass++;
+		if (pass.colorAttachments.empty()) {
+			continue;
+		}
+		for (const Use& use : pass.uses) {
+			if (use.usage == Usage::TransferSrc || use.usage == Usage::TransferDst) {
+				throw std::runtime_error("pass '" + pass.name + "' mixes color attachments and transfers [RenderGraph::compile]");
+			}
+		}
+
+		//The graph's barriers do every layout transition, inside the render pass attachments stay in one layout
+		std::vector<VkAttachmentDescription> attachments;
+		std::vector<VkAttachmentReference> references;
+		for (size_t a = 0; a < pass.colorAttachments.size(); a++) {
+			const ResourceNode& resource = m_resources[pass.colorAttachments[a]];
+			if (resource.extent.width != m_resources[pass.colorAttachments[0]].extent.width
+				|| resource.extent.height != m_resources[pass.colorAttachments[0]].extent.height) {
+				throw std::runtime_error("color attachments of pass '" + pass.name + "' differ in size [RenderGraph::compile]");
+			}
+
+			//Nothing reads a transient after its last pass
+			bool discard = !resource.imported && resource.lastPass == passIndex;
+
+			VkAttachmentDescription attachment = {};
+			attachment.format = resource.format;
+			attachment.samples = VK_SAMPLE_COUNT_1_BIT;
+			attachment.loadOp = pass.loadOps[a];
+			attachment.storeOp = discard ? VK_ATTACHMENT_STORE_OP_DONT_CARE : VK_ATTACHMENT_STORE_OP_STORE;
+			attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+			attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+			attachment.initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+			attachment.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+			attachments.push_back(attachment);
+
+			references.push_back({ static_cast<uint32_t>(a), VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL });
+		}
+
+		VkSubpassDescription subpass = {};
+		subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+		subpass.colorAttachmentCount = static_cast<uint32_t>(references.size());
+		subpass.pColorAttachments = references.data();
+
+		VkRenderPassCreateInfo renderPassInfo = {};
+		renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+		renderPassInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+		renderPassInfo.pAttachments = attachments.data();
+		renderPassInfo.subpassCount = 1;
+		renderPassInfo.pSubpasses = &subpass;
+
+		if (vkCreateRenderPass(m_device, &renderPassInfo, m_pAllocator, &pass.renderPass) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create render pass for '" + pass.name + "'! [RenderGraph::compile]");
+		}
+	}
+}
+
+void RenderGraph::bindImported(Resource resource_, VkImage image_, VkImageView view_)
+{
+	if (!m_resources[resource_].imported) {
+		throw std::runtime_error("'" + m_resources[resource_].name + "' is not imported [RenderGraph::bindImported]");
+	}
+	m_resources[resource_].image = image_;
+	m_resources[resource_].view = view_;
+}
+
+VkFramebuffer RenderGraph::framebuffer(PassNode& pass_)
+{
+	std::vector<VkImageView> views;
+	for (Resource attachment : pass_.colorAttachments) {
+		views.push_back(m_resources[attachment].view);
+	}
+
+	auto it = pass_.framebuffers.find(views);
+	if (it != pass_.framebuffers.end()) {
+		return it->second;
+	}
+
+	VkExtent2D extent = m_resources[pass_.colorAttachments[0]].extent;
+
+	VkFramebufferCreateInfo framebufferInfo = {};
+	framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+	framebufferInfo.renderPass = pass_.renderPass;
+	framebufferInfo.attachmentCount = static_cast<uint32_t>(views.size());
+	framebufferInfo.pAttachments = views.data();
+	framebufferInfo.width = extent.width;
+	framebufferInfo.height = extent.height;
+	framebufferInfo.layers = 1;
+
+	VkFramebuffer framebuffer;
+	if (vkCreateFramebuffer(m_device, &framebufferInfo, m_pAllocator, &framebuffer) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create framebuffer for '" + pass_.name + "'! [RenderGraph::framebuffer]");
+	}
+	pass_.framebuffers[views] = framebuffer;
+	return framebuffer;
+}
+
+void RenderGraph::execute(VkCommandBuffer commandBuffer_)
+{
+	if (!m_compiled) {
+		throw std::runtime_error("render graph is not compiled [RenderGraph::execute]");
+	}
+	for (const ResourceNode& resource : m_resources) {
+		if (resource.imported && resource.image == VK_NULL_HANDLE && resource.firstPass != UINT32_MAX) {
+			throw std::runtime_error("no image bound to '" + resource.name + "' [RenderGraph::execute]");
+		}
+	}
+
+	for (PassNode& pass : m_passes) {
+		if (!pass.live) {
+			continue;
+		}
+
+		recordBarriers(commandBuffer_, pass.barriers);
+
+		PassContext context;
+		context.commandBuffer = commandBuffer_;
+		context.graph = this;
+		if (!pass.uses.empty()) {
+			context.extent = m_resources[pass.uses[0].resource].extent;
+		}
+
+		if (pass.renderPass == VK_NULL_HANDLE) {
+			pass.execute(context);
+			continue;
+		}
+
+		context.renderPass = pass.renderPass;
+		context.framebuffer = framebuffer(pass);
+		context.extent = m_resources[pass.colorAttachments[0]].extent;
+
+		VkRenderPassBeginInfo renderPassInfo = {};
+		renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+		renderPassInfo.renderPass = context.renderPass;
+		renderPassInfo.framebuffer = context.framebuffer;
+		renderPassInfo.renderArea.offset = { 0, 0 };
+		renderPassInfo.renderArea.extent = context.extent;
+		renderPassInfo.clearValueCount = static_cast<uint32_t>(pass.clearValues.size());
+		renderPassInfo.pClearValues = pass.clearValues.data();
+
+		vkCmdBeginRenderPass(commandBuffer_, &renderPassInfo, pass.contents);
+		pass.execute(context);
+		vkCmdEndRenderPass(commandBuffer_);
+	}
+
+	recordBarriers(commandBuffer_, m_finalBarriers);
+}
+
+void RenderGraph::recordBarriers(VkCommandBuffer commandBuffer_, const std::vector<Barrier>& barriers_)
+{
+	if (barriers_.empty()) {
+		return;
+	}
+
+	//All barriers in front of a pass go in one call
+	std::vector<VkImageMemoryBarrier> imageBarriers;
+	VkPipelineStageFlags srcStages = 0;
+	VkPipelineStageFlags dstStages = 0;
+	for (const Barrier& barrier : barriers_) {
+		VkImageMemoryBarrier imageBarrier = {};
+		imageBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		imageBarrier.srcAccessMask = barrier.srcAccess;
+		imageBarrier.dstAccessMask = barrier.dstAccess;
+		imageBarrier.oldLayout = barrier.oldLayout;
+		imageBarrier.newLayout = barrier.newLayout;
+		imageBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		imageBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		imageBarrier.image = m_resources[barrier.resource].image;
+		imageBarrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		imageBarrier.subresourceRange.levelCount = 1;
+		imageBarrier.subresourceRange.layerCount = 1;
+		imageBarriers.push_back(imageBarrier);
+
+		srcStages |= barrier.srcStage;
+		dstStages |= barrier.dstStage;
+	}
+
+	vkCmdPipelineBarrier(commandBuffer_, srcStages != 0 ? srcStages : VkPipelineStageFlags(VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT), dstStages, 0,
+		0, nullptr, 0, nullptr, static_cast<uint32_t>(imageBarriers.size()), imageBarriers.data());
+}
+
+RenderGraph::UsageState RenderGraph::usageState(Usage usage_, bool load_)
+{
+	switch (usage_) {
+	case Usage::ColorAttachment:
+		return { VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+			VkAccessFlags(VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | (load_ ? VK_ACCESS_COLOR_ATTACHMENT_READ_BIT : 0)) };
+	case Usage::Sampled:
+		return { VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT };
+	case Usage::TransferSrc:
+		return { VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT };
+	case Usage::TransferDst:
+	default:
+		return { VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT };
+	}
+}
+
+VkImageUsageFlags RenderGraph::imageUsage(Usage usage_)
+{
+	switch (usage_) {
+	case Usage::ColorAttachment:
+		return VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+	case Usage::Sampled:
+		return VK_IMAGE_USAGE_SAMPLED_BIT;
+	case Usage::TransferSrc:
+		return VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+	case Usage::TransferDst:
+	default:
+		return VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+	}
+}
+
+void RenderGraph::printStats() const
+{
+	std::cout << "render graph: " << m_stats.passes - m_stats.culledPasses << " of " << m_stats.passes << " passes"
+		<< " (" << m_stats.culledPasses << " culled), " << m_stats.transientImages << " transient images"
+		<< " (" << m_stats.aliasedImages << " aliased), peak " << m_stats.peakBytes / 1024 << " KB"
+		<< " of " << m_stats.transientBytes / 1024 << " KB transient memory"
+		<< ", " << m_stats.imageBarriers << " image barriers in " << m_stats.barrierBatches << " batches per frame" << std::endl;
+
+	for (const PassNode& pass : m_passes) {
+		if (!pass.live) {
+			std::cout << "  culled pass '" << pass.name << "'" << std::endl;
+		}
+	}
+}
@@ -0,0 +1,153 @@
+#pragma once
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "GpuAllocator.h"
+
+//Declarative frame graph.
+//Passes declare the images they read and write, in execution order. compile() culls passes whose results never reach
+//an imported image, works out the layout transitions and barriers between the remaining ones and places transient
+//images whose lifetimes do not overlap at the same memory. execute() records the passes with those barriers.
+//Transient images are shared by all frames in flight: the first barrier of every transient waits for the last use of
+//everything placed in the same memory, which covers both aliasing inside a frame and reuse by the next frame.
+class RenderGraph {
+public:
+	typedef uint32_t Resource;
+	typedef uint32_t Pass;
+
+	enum class Usage { ColorAttachment, Sampled, TransferSrc, TransferDst };
+
+	//Handed to a pass when it is recorded. Passes with color attachments run inside their render pass.
+	struct PassContext {
+		VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+		VkRenderPass renderPass = VK_NULL_HANDLE;
+		VkFramebuffer framebuffer = VK_NULL_HANDLE;
+		VkExtent2D extent = {};
+		const RenderGraph* graph = nullptr;
+	};
+	typedef std::function<void(const PassContext&)> ExecuteFunction;
+
+	struct Stats {
+		uint32_t passes = 0;
+		uint32_t culledPasses = 0;
+		uint32_t transientImages = 0;
+		uint32_t aliasedImages = 0;			//Transients sharing memory with at least one other
+		uint32_t imageBarriers = 0;			//Per frame
+		uint32_t barrierBatches = 0;		//vkCmdPipelineBarrier calls per frame
+		VkDeviceSize transientBytes = 0;	//What the transients would need without aliasing
+		VkDeviceSize peakBytes = 0;			//What they need with it
+	};
+
+	void create(VkDevice device_, GpuAllocator* gpuAllocator_, const VkAllocationCallbacks* pAllocator_);
+	void destroy();
+
+	//Declaration, the graph is fixed once compiled
+	Resource createImage(const std::string& name_, VkFormat format_, VkExtent2D extent_);
+	Resource importImage(const std::string& name_, VkFormat format_, VkExtent2D extent_,
+		VkImageLayout initialLayout_, VkPipelineStageFlags initialStage_, VkImageLayout finalLayout_);
+	Pass addPass(const std::string& name_, ExecuteFunction execute_, VkSubpassContents contents_ = VK_SUBPASS_CONTENTS_INLINE);
+	void read(Pass pass_, Resource resource_, Usage usage_);
+	void write(Pass pass_, Resource resource_, Usage usage_);
+
+	//How a pass with color attachments records its draws, may change between executions
+	void setContents(Pass pass_, VkSubpassContents contents_) { m_passes[pass_].contents = contents_; }
+
+	void compile();
+
+	//Imported images may change every frame (the swap chain image), framebuffers are cached per set of views
+	void bindImported(Resource resource_, VkImage image_, VkImageView view_);
+	void execute(VkCommandBuffer commandBuffer_);
+
+	VkImage image(Resource resource_) const { return m_resources[resource_].image; }
+	VkExtent2D extent(Resource resource_) const { return m_resources[resource_].extent; }
+	bool isCulled(Pass pass_) const { return !m_passes[pass_].live; }
+
+	const Stats& stats() const { return m_stats; }
+	void printStats() const;
+
+private:
+	struct ResourceNode {
+		std::string name;
+		VkFormat format = VK_FORMAT_UNDEFINED;
+		VkExtent2D extent = {};
+		bool imported = false;
+		VkImageLayout initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		VkPipelineStageFlags initialStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+		VkImageLayout finalLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+		//Filled in by compile() for transients, by bindImported() for imports
+		VkImage image = VK_NULL_HANDLE;
+		VkImageView view = VK_NULL_HANDLE;
+		VkImageUsageFlags usage = 0;
+		VkMemoryRequirements requirements = {};
+		VkDeviceSize memoryOffset = 0;
+		uint32_t firstPass = UINT32_MAX;	//Lifetime in live passes
+		uint32_t lastPass = 0;
+		VkPipelineStageFlags useStages = 0;
+		VkAccessFlags writeAccess = 0;
+	};
+
+	struct Use {
+		Resource resource;
+		Usage usage;
+		bool write;
+	};
+
+	struct Barrier {
+		Resource resource;
+		VkImageLayout oldLayout;
+		VkImageLayout newLayout;
+		VkPipelineStageFlags srcStage;
+		VkPipelineStageFlags dstStage;
+		VkAccessFlags srcAccess;
+		VkAccessFlags dstAccess;
+		bool firstUse;	//Source scope comes from the memory placement
+	};
+
+	struct PassNode {
+		std::string name;
+		ExecuteFunction execute;
+		VkSubpassContents contents = VK_SUBPASS_CONTENTS_INLINE;
+		std::vector<Use> uses;
+		bool live = false;
+
+		std::vector<Barrier> barriers;
+		std::vector<Resource> colorAttachments;
+		std::vector<VkAttachmentLoadOp> loadOps;
+		std::vector<VkClearValue> clearValues;
+		VkRenderPass renderPass = VK_NULL_HANDLE;
+		std::map<std::vector<VkImageView>, VkFramebuffer> framebuffers;
+	};
+
+	//Layout, stage and access a usage implies
+	struct UsageState {
+		VkImageLayout layout;
+		VkPipelineStageFlags stage;
+		VkAccessFlags access;
+	};
+	static UsageState usageState(Usage usage_, bool load_);
+	static VkImageUsageFlags imageUsage(Usage usage_);
+
+	void cullPasses();
+	void computeBarriers();
+	void placeTransients();
+	void createRenderPasses();
+	VkFramebuffer framebuffer(PassNode& pass_);
+	void recordBarriers(VkCommandBuffer commandBuffer_, const std::vector<Barrier>& barriers_);
+
+	VkDevice m_device = VK_NULL_HANDLE;
+	GpuAllocator* m_gpuAllocator = nullptr;
+	const VkAllocationCallbacks* m_pAllocator = nullptr;
+
+	std::vector<ResourceNode> m_resources;
+	std::vector<PassNode> m_passes;
+	std::vector<Barrier> m_finalBarriers;
+	GpuAllocation m_transientMemory;
+	bool m_compiled = false;
+	Stats m_stats;
+};
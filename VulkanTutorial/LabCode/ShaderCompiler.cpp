@@ -0,0 +1,382 @@
+#include "ShaderCompiler.h"
+
+#include <chrono>
+#include <cstring>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+
+#ifdef LAB_USE_SHADERC
+#include <shaderc/shaderc.h>
+#endif
+
+namespace {
+
+	//Bump when the cache file contents or the key layout change
+	const char* SHADER_CACHE_VERSION = "spvcache1";
+	const size_t MAX_INCLUDE_DEPTH = 16;
+
+	bool readTextFile(const std::string& path_, std::string& text_)
+	{
+		std::ifstream file(path_, std::ios::binary);
+		if (!file.is_open()) {
+			return false;
+		}
+
+		std::ostringstream stream;
+		stream << file.rdbuf();
+		text_ = stream.str();
+		return true;
+	}
+
+	//64 bit FNV-1a, good enough to tell shader variants apart
+	uint64_t hashBytes(uint64_t hash_, const void* data_, size_t size_)
+	{
+		const unsigned char* bytes = static_cast<const unsigned char*>(data_);
+		for (size_t i = 0; i < size_; i++) {
+			hash_ ^= bytes[i];
+			hash_ *= 1099511628211ull;
+		}
+		return hash_;
+	}
+
+	uint64_t hashString(uint64_t hash_, const std::string& text_)
+	{
+		//Length first so "ab"+"c" and "a"+"bc" differ
+		uint64_t length = text_.size();
+		hash_ = hashBytes(hash_, &length, sizeof(length));
+		return hashBytes(hash_, text_.data(), text_.size());
+	}
+
+	std::string resolveInclude(const std::string& requestingPath_, const std::string& requested_)
+	{
+		return (std::filesystem::path(requestingPath_).parent_path() / requested_).lexically_normal().generic_string();
+	}
+
+	//Collects the files included by path_ in the order they appear, following nested includes
+	void collectIncludes(const std::string& path_, const std::string& source_, std::set<std::string>& visited_, std::vector<std::string>& includes_, size_t depth_)
+	{
+		if (depth_ > MAX_INCLUDE_DEPTH) {
+			return;
+		}
+
+		std::istringstream lines(source_);
+		std::string line;
+		while (std::getline(lines, line)) {
+			size_t directive = line.find("#include");
+			if (directive == std::string::npos || line.find_first_not_of(" \t") != directive) {
+				continue;
+			}
+
+			size_t open = line.find_first_of("\"<", directive);
+			size_t close = open == std::string::npos ? std::string::npos : line.find_first_of("\">", open + 1);
+			if (close == std::string::npos) {
+				continue;
+			}
+
+			std::string includePath = resolveInclude(path_, line.substr(open + 1, close - open - 1));
+			if (!visited_.insert(includePath).second) {
+				continue;
+			}
+			includes_.push_back(includePath);
+
+			std::string includeSource;
+			if (readTextFile(includePath, includeSource)) {
+				collectIncludes(includePath, includeSource, visited_, includes_, depth_ + 1);
+			}
+		}
+	}
+
+	//Whole words starting with the SPIR-V magic number, anything else is a truncated or foreign file
+	bool isSpirv(const char* data_, size_t size_)
+	{
+		const uint32_t SPIRV_MAGIC = 0x07230203;
+		return size_ >= sizeof(uint32_t) && size_ % sizeof(uint32_t) == 0 && *reinterpret_cast<const uint32_t*>(data_) == SPIRV_MAGIC;
+	}
+
+	const char* stageName(ShaderCompiler::Stage stage_)
+	{
+		switch (stage_) {
+		case ShaderCompiler::Stage::Fragment: return "frag";
+		case ShaderCompiler::Stage::Compute: return "comp";
+		default: return "vert";
+		}
+	}
+
+#ifdef LAB_USE_SHADERC
+	//Owns the strings an include result points at, freed in releaseIncludeCallback
+	struct IncludeData {
+		shaderc_include_result result;
+		std::string name;
+		std::string content;
+	};
+
+	shaderc_include_result* resolveIncludeCallback(void* userData_, const char* requestedSource_, int type_, const char* requestingSource_, size_t includeDepth_)
+	{
+		IncludeData* data = new IncludeData();
+		data->name = resolveInclude(requestingSource_, requestedSource_);
+		if (!readTextFile(data->name, data->content)) {
+			data->content = "failed to open include file '" + data->name + "'";
+			data->name.clear();
+		}
+
+		data->result.source_name = data->name.c_str();
+		data->result.source_name_length = data->name.size();
+		data->result.content = data->content.c_str();
+		data->result.content_length = data->content.size();
+		data->result.user_data = data;
+		return &data->result;
+	}
+
+	void releaseIncludeCallback(void* userData_, shaderc_include_result* result_)
+	{
+		delete static_cast<IncludeData*>(result_->user_data);
+	}
+#endif
+}
+
+void ShaderCompiler::create(const std::string& cacheDirectory_)
+{
+	m_cacheDirectory = cacheDirectory_;
+
+	std::error_code error;
+	std::filesystem::create_directories(m_cacheDirectory, error);
+	if (error) {
+		std::cerr << "failed to create shader cache directory '" << m_cacheDirectory << "' [ShaderCompiler::create]" << std::endl;
+	}
+
+#ifdef LAB_USE_SHADERC
+	m_compiler = shaderc_compiler_initialize();
+#endif
+}
+
+void ShaderCompiler::destroy()
+{
+#ifdef LAB_USE_SHADERC
+	if (m_compiler) {
+		shaderc_compiler_release(static_cast<shaderc_compiler_t>(m_compiler));
+	}
+#endif
+	m_compiler = nullptr;
+}
+
+const uint32_t* ShaderCompiler::Spirv::code() const
+{
+	if (archived.data) {
+		return reinterpret_cast<const uint32_t*>(archived.data);
+	}
+	return view.isOpen() ? view.as<uint32_t>(0, view.size() / sizeof(uint32_t)) : words.data();
+}
+
+size_t ShaderCompiler::Spirv::size() const
+{
+	if (archived.data) {
+		return archived.size;
+	}
+	return view.isOpen() ? view.size() : words.size() * sizeof(uint32_t);
+}
+
+ShaderCompiler::Spirv ShaderCompiler::load(const ShaderDesc& desc_)
+{
+	Spirv spirv;
+
+	//0. Packed builds, one lookup in the already mapped archive
+	if (m_archive && !desc_.fallbackSpirvPath.empty()) {
+		std::string name = std::filesystem::path(desc_.fallbackSpirvPath).filename().generic_string();
+		if (m_archive->load(name, spirv.archived)) {
+			if (!isSpirv(spirv.archived.data, spirv.archived.size)) {
+				throw std::runtime_error("archive entry '" + name + "' is not a SPIR-V module [ShaderCompiler::load]");
+			}
+
+			std::lock_guard<std::mutex> lock(m_statsMutex);
+			m_stats.archived++;
+			m_stats.spirvBytes += spirv.size();
+			return spirv;
+		}
+	}
+
+	FileView source;
+	if (!source.tryOpen(desc_.sourcePath)) {
+		throw std::runtime_error("failed to open shader source '" + desc_.sourcePath + "' [ShaderCompiler::load]");
+	}
+
+	//1. Cache hit, no compiler involved and the SPIR-V is used straight from the mapping
+	std::string path = cachePath(cacheKey(desc_, source));
+	if (spirv.view.tryOpen(path) && isSpirv(spirv.view.data(), spirv.view.size())) {
+		std::lock_guard<std::mutex> lock(m_statsMutex);
+		m_stats.hits++;
+		m_stats.spirvBytes += spirv.size();
+		return spirv;
+	}
+	spirv.view.close();
+
+	//2. Miss without a compiler, use the offline build
+	if (!m_compiler) {
+		if (desc_.fallbackSpirvPath.empty()) {
+			throw std::runtime_error("no cached SPIR-V for '" + desc_.sourcePath + "' and shaderc is not available [ShaderCompiler::load]");
+		}
+
+		spirv.view.open(desc_.fallbackSpirvPath);
+		if (!isSpirv(spirv.view.data(), spirv.view.size())) {
+			throw std::runtime_error("'" + desc_.fallbackSpirvPath + "' is not a SPIR-V module [ShaderCompiler::load]");
+		}
+
+		std::lock_guard<std::mutex> lock(m_statsMutex);
+		m_stats.fallbacks++;
+		m_stats.spirvBytes += spirv.size();
+		return spirv;
+	}
+
+	//3. Compile and store, through a temporary file so concurrent launches never read a partial entry
+	//and a mapping of the previous entry never sees the file change underneath it
+	auto start = std::chrono::high_resolution_clock::now();
+	spirv.words = compile(desc_, source);
+	double compileMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+	std::string tmpPath = path + ".tmp";
+	bool written;
+	{
+		std::ofstream file(tmpPath, std::ios::binary | std::ios::trunc);
+		file.write(reinterpret_cast<const char*>(spirv.words.data()), spirv.size());
+		file.close();
+		written = file.good();
+	}
+
+	//A short entry must never replace a good one, the compiled words are still returned either way
+	if (!written) {
+		std::remove(tmpPath.c_str());
+		std::cerr << "failed to write '" << tmpPath << "' [ShaderCompiler::load]" << std::endl;
+	}
+	else {
+		std::remove(path.c_str());
+		if (std::rename(tmpPath.c_str(), path.c_str()) != 0) {
+			std::cerr << "failed to write shader cache entry '" << path << "' [ShaderCompiler::load]" << std::endl;
+		}
+	}
+
+	std::lock_guard<std::mutex> lock(m_statsMutex);
+	m_stats.misses++;
+	m_stats.compileMs += compileMs;
+	m_stats.spirvBytes += spirv.size();
+	return spirv;
+}
+
+std::vector<std::string> ShaderCompiler::dependencies(const std::string& sourcePath_) const
+{
+	std::vector<std::string> files = { std::filesystem::path(sourcePath_).lexically_normal().generic_string() };
+
+	std::string source;
+	if (readTextFile(sourcePath_, source)) {
+		std::set<std::string> visited = { files[0] };
+		collectIncludes(files[0], source, visited, files, 0);
+	}
+	return files;
+}
+
+ShaderCompiler::Stats ShaderCompiler::stats() const
+{
+	std::lock_guard<std::mutex> lock(m_statsMutex);
+	return m_stats;
+}
+
+void ShaderCompiler::printStats() const
+{
+	Stats stats = this->stats();
+	uint32_t loads = stats.hits + stats.misses + stats.fallbacks + stats.archived;
+	if (loads == 0) {
+		return;
+	}
+
+	std::cout << "shader cache: " << stats.hits << " hits, " << stats.misses << " compiled, " << stats.fallbacks << " offline fallbacks, " << stats.archived << " from the archive"
+		<< ", hit ratio " << 100.0 * stats.hits / loads << "%"
+		<< ", compile time " << stats.compileMs << " ms"
+		<< ", " << stats.spirvBytes << " bytes of SPIR-V loaded" << std::endl;
+}
+
+uint64_t ShaderCompiler::cacheKey(const ShaderDesc& desc_, const FileView& source_) const
+{
+	uint64_t hash = 14695981039346656037ull;
+	hash = hashString(hash, SHADER_CACHE_VERSION);
+	hash = hashString(hash, stageName(desc_.stage));
+	hash = hashBytes(hash, source_.data(), source_.size());
+
+	//Include contents, not just their names, so editing a shared header invalidates every user
+	std::vector<std::string> files = dependencies(desc_.sourcePath);
+	for (size_t i = 1; i < files.size(); i++) {
+		std::string include;
+		readTextFile(files[i], include);
+		hash = hashString(hash, files[i]);
+		hash = hashString(hash, include);
+	}
+
+	for (const Define& define : desc_.defines) {
+		hash = hashString(hash, define.name);
+		hash = hashString(hash, define.value);
+	}
+
+	//Compile options, keep in sync with compile()
+#ifdef NDEBUG
+	hash = hashString(hash, "entry=main;env=vulkan1.0;opt=performance");
+#else
+	hash = hashString(hash, "entry=main;env=vulkan1.0;opt=zero;debug");
+#endif
+	return hash;
+}
+
+std::string ShaderCompiler::cachePath(uint64_t key_) const
+{
+	std::ostringstream name;
+	name << std::hex << std::setw(16) << std::setfill('0') << key_ << ".spv";
+	return (std::filesystem::path(m_cacheDirectory) / name.str()).generic_string();
+}
+
+std::vector<uint32_t> ShaderCompiler::compile(const ShaderDesc& desc_, const FileView& source_)
+{
+#ifdef LAB_USE_SHADERC
+	shaderc_compile_options_t options = shaderc_compile_options_initialize();
+	for (const Define& define : desc_.defines) {
+		shaderc_compile_options_add_macro_definition(options, define.name.c_str(), define.name.size(), define.value.c_str(), define.value.size());
+	}
+	shaderc_compile_options_set_target_env(options, shaderc_target_env_vulkan, shaderc_env_version_vulkan_1_0);
+	shaderc_compile_options_set_include_callbacks(options, resolveIncludeCallback, releaseIncludeCallback, nullptr);
+#ifdef NDEBUG
+	shaderc_compile_options_set_optimization_level(options, shaderc_optimization_level_performance);
+#else
+	shaderc_compile_options_set_optimization_level(options, shaderc_optimization_level_zero);
+	shaderc_compile_options_set_generate_debug_info(options);
+#endif
+
+	shaderc_shader_kind kind = shaderc_glsl_vertex_shader;
+	if (desc_.stage == Stage::Fragment) {
+		kind = shaderc_glsl_fragment_shader;
+	}
+	else if (desc_.stage == Stage::Compute) {
+		kind = shaderc_glsl_compute_shader;
+	}
+
+	shaderc_compilation_result_t result = shaderc_compile_into_spv(static_cast<shaderc_compiler_t>(m_compiler),
+		source_.data(), source_.size(), kind, desc_.sourcePath.c_str(), "main", options);
+	shaderc_compile_options_release(options);
+
+	if (shaderc_result_get_compilation_status(result) != shaderc_compilation_status_success) {
+		std::string message = shaderc_result_get_error_message(result);
+		shaderc_result_release(result);
+		throw std::runtime_error("failed to compile '" + desc_.sourcePath + "':\n" + message + " [ShaderCompiler::compile]");
+	}
+
+	//The result bytes carry no alignment guarantee, copy them into words once
+	std::vector<uint32_t> spirv(shaderc_result_get_length(result) / sizeof(uint32_t));
+	memcpy(spirv.data(), shaderc_result_get_bytes(result), spirv.size() * sizeof(uint32_t));
+	shaderc_result_release(result);
+	return spirv;
+#else
+	(void)desc_;
+	(void)source_;
+	throw std::runtime_error("built without LAB_USE_SHADERC [ShaderCompiler::compile]");
+#endif
+}
@@ -0,0 +1,83 @@
+#pragma once
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "AssetArchive.h"
+#include "FileView.h"
+
+//Compiles GLSL to SPIR-V in process with shaderc and keeps the results in an on-disk cache.
+//The cache key hashes the source, every file it includes, the macro defines and the compile options,
+//so a launch with unchanged shaders never invokes the compiler.
+//shaderc is only linked when LAB_USE_SHADERC is defined, build with /p:LabUseShaderc=true to define it and link
+//shaderc_shared.lib from the Vulkan SDK. The default build has no compiler, a cache miss then loads the committed
+//SPIR-V in shaders/, which compileTriangle.bat rebuilds after a shader source changes.
+class ShaderCompiler {
+public:
+	enum class Stage { Vertex, Fragment, Compute };
+
+	struct Define {
+		std::string name;
+		std::string value;
+	};
+
+	struct ShaderDesc {
+		std::string sourcePath;
+		Stage stage = Stage::Vertex;
+		std::vector<Define> defines;
+
+		//Offline compiled SPIR-V used on a cache miss when shaderc is not available.
+		//Its file name is also the entry looked up in the asset archive.
+		std::string fallbackSpirvPath;
+	};
+
+	//SPIR-V of one shader, used in place from the archive or a mapped file, or owned after a compile or decompression.
+	//Either way the words are 4 byte aligned and can be handed to vkCreateShaderModule without a copy.
+	struct Spirv {
+		AssetArchive::Asset archived;
+		FileView view;
+		std::vector<uint32_t> words;
+
+		const uint32_t* code() const;
+		size_t size() const;
+	};
+
+	struct Stats {
+		uint32_t hits = 0;
+		uint32_t misses = 0;
+		uint32_t fallbacks = 0;
+		uint32_t archived = 0;
+		double compileMs = 0.0;
+		size_t spirvBytes = 0;
+	};
+
+	void create(const std::string& cacheDirectory_);
+	void destroy();
+
+	//Shaders found in archive_ are served from it without touching their sources or the cache.
+	//The archive must stay open while the returned SPIR-V is in use.
+	void setArchive(const AssetArchive* archive_) { m_archive = archive_; }
+
+	//Returns the SPIR-V for desc_, throws with the compiler log if compilation fails.
+	//Safe to call from several threads at once.
+	Spirv load(const ShaderDesc& desc_);
+
+	//The source file and everything it includes, resolved relative to the including file
+	std::vector<std::string> dependencies(const std::string& sourcePath_) const;
+
+	Stats stats() const;
+	void printStats() const;
+
+private:
+	uint64_t cacheKey(const ShaderDesc& desc_, const FileView& source_) const;
+	std::string cachePath(uint64_t key_) const;
+	std::vector<uint32_t> compile(const ShaderDesc& desc_, const FileView& source_);
+
+	std::string m_cacheDirectory;
+	void* m_compiler = nullptr;
+	const AssetArchive* m_archive = nullptr;
+
+	mutable std::mutex m_statsMutex;
+	Stats m_stats;
+};
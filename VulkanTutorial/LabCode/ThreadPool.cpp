@@ -0,0 +1,68 @@
+#include "ThreadPool.h"
+
+ThreadPool::ThreadPool(uint32_t threadCount_)
+{
+	for (uint32_t i = 0; i < threadCount_; i++) {
+		m_threads.emplace_back(&ThreadPool::workerLoop, this, i);
+	}
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stopping = true;
+	}
+	m_condition.notify_all();
+
+	for (auto& thread : m_threads) {
+		thread.join();
+	}
+}
+
+void ThreadPool::parallelFor(uint32_t taskCount_, const std::function<void(uint32_t, uint32_t)>& job_)
+{
+	std::vector<std::future<void>> futures;
+	futures.reserve(taskCount_);
+
+	for (uint32_t i = 0; i < taskCount_; i++) {
+		futures.push_back(submit([&job_, i](uint32_t workerIndex_) { job_(i, workerIndex_); }));
+	}
+
+	//get() rethrows the first exception raised by a task on the calling thread
+	for (auto& future : futures) {
+		future.wait();
+	}
+	for (auto& future : futures) {
+		future.get();
+	}
+}
+
+void ThreadPool::enqueue(std::function<void(uint32_t)> job_)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_jobs.push_back(std::move(job_));
+	}
+	m_condition.notify_one();
+}
+
+void ThreadPool::workerLoop(uint32_t workerIndex_)
+{
+	for (;;) {
+		std::function<void(uint32_t)> job;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_condition.wait(lock, [this]() { return m_stopping || !m_jobs.empty(); });
+
+			if (m_stopping && m_jobs.empty()) {
+				return;
+			}
+
+			job = std::move(m_jobs.front());
+			m_jobs.pop_front();
+		}
+
+		job(workerIndex_);
+	}
+}
@@ -0,0 +1,49 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+
+//Fixed size pool of worker threads.
+//Every job receives the index of the worker running it, so callers can keep per worker
+//resources (like command pools) which are only ever touched from one thread.
+class ThreadPool {
+public:
+	explicit ThreadPool(uint32_t threadCount_);
+	~ThreadPool();
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	uint32_t threadCount() const { return static_cast<uint32_t>(m_threads.size()); }
+
+	//Queues job_(workerIndex) and returns a future for its result
+	template<typename Job>
+	auto submit(Job&& job_) -> std::future<decltype(job_(0u))>
+	{
+		using Result = decltype(job_(0u));
+		auto task = std::make_shared<std::packaged_task<Result(uint32_t)>>(std::forward<Job>(job_));
+		std::future<Result> future = task->get_future();
+
+		enqueue([task](uint32_t workerIndex_) { (*task)(workerIndex_); });
+		return future;
+	}
+
+	//Runs job_(taskIndex, workerIndex) for every taskIndex in [0, taskCount_) and blocks until all are done
+	void parallelFor(uint32_t taskCount_, const std::function<void(uint32_t, uint32_t)>& job_);
+
+private:
+	void enqueue(std::function<void(uint32_t)> job_);
+	void workerLoop(uint32_t workerIndex_);
+
+	std::vector<std::thread> m_threads;
+	std::deque<std::function<void(uint32_t)>> m_jobs;
+	std::mutex m_mutex;
+	std::condition_variable m_condition;
+	bool m_stopping = false;
+};
@@ -0,0 +1,110 @@
+#include "UniformRing.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+void UniformRing::create(VkDevice device_, GpuAllocator* gpuAllocator_, VkDeviceSize minOffsetAlignment_, uint32_t regionCount_,
+	VkDeviceSize regionSize_, VkBufferUsageFlags usage_, const VkAllocationCallbacks* pAllocator_)
+{
+	m_device = device_;
+	m_gpuAllocator = gpuAllocator_;
+	m_pAllocator = pAllocator_;
+
+	//1. The limit is a power of two, regions start on it so every returned offset is a valid dynamic offset
+	m_alignment = std::max<VkDeviceSize>(minOffsetAlignment_, 16);
+	m_regionSize = (regionSize_ + m_alignment - 1) & ~(m_alignment - 1);
+	m_regionCount = regionCount_;
+
+	VkBufferCreateInfo bufferInfo = {};
+	bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	bufferInfo.size = m_regionSize * m_regionCount;
+	bufferInfo.usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | usage_;
+	bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+	if (vkCreateBuffer(m_device, &bufferInfo, m_pAllocator, &m_buffer) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create uniform ring buffer! [UniformRing::create]");
+	}
+
+	//2. Host visible memory is mapped for its whole lifetime by the allocator, coherent memory needs no flushes
+	m_gpuAllocator->allocateBufferMemory(m_buffer, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, m_memory);
+	m_mapped = static_cast<char*>(m_memory.mapped);
+	if (m_mapped == nullptr) {
+		throw std::runtime_error("uniform ring memory is not mapped [UniformRing::create]");
+	}
+}
+
+void UniformRing::destroy()
+{
+	if (m_buffer == VK_NULL_HANDLE) {
+		return;
+	}
+
+	vkDestroyBuffer(m_device, m_buffer, m_pAllocator);
+	m_gpuAllocator->free(m_memory);
+	m_buffer = VK_NULL_HANDLE;
+	m_mapped = nullptr;
+}
+
+void UniformRing::beginFrame(uint32_t region_)
+{
+	if (region_ >= m_regionCount) {
+		throw std::runtime_error("uniform ring region out of range [UniformRing::beginFrame]");
+	}
+
+	recordFrameStats();
+	m_regionBase = region_ * m_regionSize;
+	m_head.store(0, std::memory_order_relaxed);
+	m_frameStarted = true;
+}
+
+uint32_t UniformRing::push(const void* data_, VkDeviceSize size_)
+{
+	VkDeviceSize alignedSize = (size_ + m_alignment - 1) & ~(m_alignment - 1);
+	VkDeviceSize offset = m_head.fetch_add(alignedSize, std::memory_order_relaxed);
+	if (offset + size_ > m_regionSize) {
+		throw std::runtime_error("uniform ring region of " + std::to_string(m_regionSize) + " bytes is full [UniformRing::push]");
+	}
+
+	memcpy(m_mapped + m_regionBase + offset, data_, static_cast<size_t>(size_));
+	return static_cast<uint32_t>(m_regionBase + offset);
+}
+
+void UniformRing::recordFrameStats()
+{
+	if (!m_frameStarted) {
+		return;
+	}
+
+	VkDeviceSize bytes = std::min(m_head.load(std::memory_order_relaxed), m_regionSize);
+	m_stats.frames++;
+	m_stats.peakBytes = std::max(m_stats.peakBytes, bytes);
+	m_stats.totalBytes += bytes;
+}
+
+UniformRing::Stats UniformRing::stats() const
+{
+	//Includes the frame being filled
+	Stats stats = m_stats;
+	if (m_frameStarted) {
+		VkDeviceSize bytes = std::min(m_head.load(std::memory_order_relaxed), m_regionSize);
+		stats.frames++;
+		stats.peakBytes = std::max(stats.peakBytes, bytes);
+		stats.totalBytes += bytes;
+	}
+	return stats;
+}
+
+void UniformRing::printStats() const
+{
+	Stats current = stats();
+	if (current.frames == 0) {
+		return;
+	}
+
+	std::cout << "uniform ring: " << m_regionCount << " regions of " << m_regionSize / 1024 << " KB"
+		<< ", alignment " << m_alignment << " bytes, " << current.frames << " frames"
+		<< ", avg " << current.totalBytes / current.frames / 1024.0 << " KB, peak " << current.peakBytes / 1024.0 << " KB per frame" << std::endl;
+}
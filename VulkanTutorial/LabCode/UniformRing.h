@@ -0,0 +1,64 @@
+#pragma once
+#include <vulkan/vulkan.h>
+
+#include <atomic>
+#include <cstdint>
+
+#include "GpuAllocator.h"
+
+//Uniform data for many draws in one persistently mapped, host coherent buffer.
+//The buffer is split into regions, one per frame in flight. A frame resets its region once the GPU is done with it,
+//after that every push is one atomic bump of the region's head (aligned to minUniformBufferOffsetAlignment) and a
+//memcpy. One VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC descriptor covers the whole buffer, so a draw selects its data
+//with the returned dynamic offset instead of a descriptor update.
+class UniformRing {
+public:
+	struct Stats {
+		uint64_t frames = 0;
+		VkDeviceSize peakBytes = 0;		//Most bytes one frame pushed
+		VkDeviceSize totalBytes = 0;
+	};
+
+	//usage_ is added to VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, for example to also read the ring as a storage buffer
+	void create(VkDevice device_, GpuAllocator* gpuAllocator_, VkDeviceSize minOffsetAlignment_, uint32_t regionCount_,
+		VkDeviceSize regionSize_, VkBufferUsageFlags usage_, const VkAllocationCallbacks* pAllocator_);
+	void destroy();
+
+	//Starts filling region_ from the beginning, whatever read it before must have completed
+	void beginFrame(uint32_t region_);
+
+	//Copies size_ bytes into the current region and returns their offset in buffer(). Safe to call from several
+	//threads between two beginFrame() calls. Throws when the region is full.
+	uint32_t push(const void* data_, VkDeviceSize size_);
+
+	template<typename T>
+	uint32_t push(const T& value_) { return push(&value_, sizeof(T)); }
+
+	VkBuffer buffer() const { return m_buffer; }
+	VkDeviceSize alignment() const { return m_alignment; }
+	VkDeviceSize regionSize() const { return m_regionSize; }
+
+	Stats stats() const;
+	void printStats() const;
+
+private:
+	void recordFrameStats();
+
+	VkDevice m_device = VK_NULL_HANDLE;
+	GpuAllocator* m_gpuAllocator = nullptr;
+	const VkAllocationCallbacks* m_pAllocator = nullptr;
+
+	VkBuffer m_buffer = VK_NULL_HANDLE;
+	GpuAllocation m_memory;
+	char* m_mapped = nullptr;
+
+	VkDeviceSize m_alignment = 256;
+	VkDeviceSize m_regionSize = 0;
+	uint32_t m_regionCount = 0;
+
+	VkDeviceSize m_regionBase = 0;
+	std::atomic<VkDeviceSize> m_head{ 0 };
+	bool m_frameStarted = false;
+
+	Stats m_stats;
+};
@@ -0,0 +1,16 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+layout(location = 0) in vec2 inPosition;
+layout(location = 1) in vec3 inColor;
+
+layout(location = 0) out vec3 fragColor;
+
+layout(set = 0, binding = 0) uniform DrawUniforms {
+	mat4 transform;
+} draw;
+
+void main() {
+	gl_Position = draw.transform * vec4(inPosition, 0.0, 1.0);
+	fragColor = inColor;
+}
@@ -0,0 +1,23 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_EXT_nonuniform_qualifier : require
+
+layout(location = 0) in vec2 inPosition;
+layout(location = 1) in vec3 inColor;
+
+layout(location = 0) out vec3 fragColor;
+
+//Every storage buffer of the bindless table, the draw data lives in one of them
+layout(set = 0, binding = 0) readonly buffer DrawBuffer {
+	mat4 transforms[];
+} drawBuffers[];
+
+layout(push_constant) uniform DrawConstants {
+	uint drawBuffer;
+	uint drawIndex;
+} draw;
+
+void main() {
+	gl_Position = drawBuffers[draw.drawBuffer].transforms[draw.drawIndex] * vec4(inPosition, 0.0, 1.0);
+	fragColor = inColor;
+}
@@ -0,0 +1,16 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+layout(location = 0) in vec2 inPosition;
+layout(location = 1) in vec3 inColor;
+
+//Per instance stream, binding 1
+layout(location = 2) in vec4 inTransform;
+layout(location = 3) in vec3 inInstanceColor;
+
+layout(location = 0) out vec3 fragColor;
+
+void main() {
+	gl_Position = vec4(inPosition * inTransform.xy + inTransform.zw, 0.0, 1.0);
+	fragColor = inColor * inInstanceColor;
+}
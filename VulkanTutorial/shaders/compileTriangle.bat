@@ -1,3 +1,6 @@
 ..\..\External\Tools\glslc.exe TriangleShader.vert -o Triangle_vert.spv
 ..\..\External\Tools\glslc.exe TriangleShader.frag -o Triangle_frag.spv
+..\..\External\Tools\glslc.exe VertexBuffer.vert -o VertexBuffer_vert.spv
+..\..\External\Tools\glslc.exe VertexBufferBindless.vert -o VertexBufferBindless_vert.spv
+..\..\External\Tools\glslc.exe VertexBufferInstanced.vert -o VertexBufferInstanced_vert.spv
 pause
\ No newline at end of file